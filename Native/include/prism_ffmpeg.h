@@ -37,9 +37,22 @@ typedef enum PrismPixelFormat {
     PRISM_PIXEL_FORMAT_RGBA = 0,
     PRISM_PIXEL_FORMAT_BGRA = 1,
     PRISM_PIXEL_FORMAT_RGB24 = 2,
-    PRISM_PIXEL_FORMAT_YUV420P = 3
+    PRISM_PIXEL_FORMAT_YUV420P = 3,
+    PRISM_PIXEL_FORMAT_NV12 = 4
 } PrismPixelFormat;
 
+/* YUV to RGB matrix of planar output (for shader-side conversion) */
+typedef enum PrismColorMatrix {
+    PRISM_COLOR_MATRIX_BT601 = 0,
+    PRISM_COLOR_MATRIX_BT709 = 1,
+    PRISM_COLOR_MATRIX_BT2020 = 2
+} PrismColorMatrix;
+
+typedef enum PrismColorRange {
+    PRISM_COLOR_RANGE_LIMITED = 0,  /* Y 16-235, UV 16-240 */
+    PRISM_COLOR_RANGE_FULL = 1      /* 0-255 */
+} PrismColorRange;
+
 typedef enum PrismState {
     PRISM_STATE_IDLE = 0,
     PRISM_STATE_OPENING = 1,
@@ -66,6 +79,34 @@ typedef enum PrismError {
     PRISM_ERROR_INVALID_PARAMETER = -11
 } PrismError;
 
+/* Seek precision */
+typedef enum PrismSeekMode {
+    PRISM_SEEK_KEYFRAME = 0,        /* Fast: resume from the keyframe at or before the target */
+    PRISM_SEEK_EXACT = 1            /* Decode from the keyframe and discard up to the exact target frame and sample */
+} PrismSeekMode;
+
+/* Video decoder threading */
+typedef enum PrismThreadMode {
+    PRISM_THREAD_MODE_AUTO = 0,     /* Frame + slice threading (slice only for live streams) */
+    PRISM_THREAD_MODE_FRAME = 1,    /* Frame threading: best throughput, adds one frame of latency per thread */
+    PRISM_THREAD_MODE_SLICE = 2     /* Slice threading: no added latency, codec/stream dependent */
+} PrismThreadMode;
+
+/* How much work Open spends probing the source */
+typedef enum PrismOpenProfile {
+    PRISM_OPEN_PROFILE_DEFAULT = 0, /* FFmpeg's probe limits, full stream info probing */
+    PRISM_OPEN_PROFILE_FAST = 1     /* Small probe limits; skip stream info probing when the container
+                                     * header describes the streams or a previous Open of the same URL
+                                     * was cached */
+} PrismOpenProfile;
+
+/* How Open reads local files */
+typedef enum PrismFileBackend {
+    PRISM_FILE_BACKEND_DEFAULT = 0, /* FFmpeg's file protocol */
+    PRISM_FILE_BACKEND_MMAP = 1     /* Memory-mapped with sequential read-ahead hints; falls back to
+                                     * the default when the file cannot be mapped */
+} PrismFileBackend;
+
 /* Video frame info */
 typedef struct PrismVideoInfo {
     int width;
@@ -78,6 +119,21 @@ typedef struct PrismVideoInfo {
     const char* codec_name;
 } PrismVideoInfo;
 
+/* Per-plane view of the current video frame.
+ * YUV420P: Y, U, V planes. NV12: Y plane and interleaved UV plane.
+ * Packed RGB formats: a single plane. Chroma planes are half width and height. */
+typedef struct PrismVideoPlanes {
+    PrismPixelFormat format;
+    int width;
+    int height;
+    int plane_count;
+    const uint8_t* data[3];
+    int stride[3];
+    PrismColorMatrix matrix;
+    PrismColorRange range;
+    double pts;
+} PrismVideoPlanes;
+
 /* Audio info */
 typedef struct PrismAudioInfo {
     int sample_rate;
@@ -87,9 +143,85 @@ typedef struct PrismAudioInfo {
     const char* codec_name;
 } PrismAudioInfo;
 
+/* Playback pipeline statistics */
+typedef struct PrismPlayerStats {
+    int64_t frames_converted;   /* Frames run through color conversion (native-format frames are not counted) */
+    double convert_ms_last;     /* Color conversion time of the last frame, in milliseconds */
+    double convert_ms_avg;      /* Average color conversion time since Open */
+    double convert_ms_max;      /* Slowest color conversion since Open */
+    int convert_threads;        /* Slice threads used for color conversion */
+    int decode_threads;         /* Threads used by the video decoder */
+    int index_keyframes;        /* Keyframes the background index added to the demuxer's (0 until built) */
+    double open_ms;             /* Duration of the last Open, in milliseconds */
+    double probe_ms;            /* Part of open_ms spent probing stream info (0 when skipped) */
+    int open_warm;              /* 1 if the last Open skipped probing (header or cached stream info) */
+    double live_latency;        /* Low latency: seconds the displayed frame is behind the newest demuxed one */
+    double live_rate;           /* Low latency: current catch-up playback rate (0.95 - 1.05) */
+    int64_t live_frames_dropped; /* Low latency: frames dropped past the hard latency threshold */
+    int64_t read_ahead_buffered; /* Read-ahead: bytes buffered ahead of the demuxer */
+    double read_ahead_fill_rate; /* Read-ahead: network throughput while filling, bytes per second */
+    int64_t read_ahead_stalls;  /* Read-ahead: demuxer reads that found the buffer empty */
+    double demux_read_ms;       /* Time spent in av_read_frame since Open */
+    int64_t demux_bytes;        /* Bytes the demuxer has read from its input since Open */
+    int file_backend;           /* PrismFileBackend the open media is read with */
+} PrismPlayerStats;
+
+/* Why the adaptive bitrate controller last switched variants */
+typedef enum PrismAbrReason {
+    PRISM_ABR_REASON_NONE = 0,
+    PRISM_ABR_REASON_BANDWIDTH_UP = 1,      /* Measured bandwidth allows a higher bitrate */
+    PRISM_ABR_REASON_BANDWIDTH_DOWN = 2,    /* Measured bandwidth is below the current bitrate */
+    PRISM_ABR_REASON_DECODE_HEADROOM = 3    /* Decoding and conversion are close to the frame duration */
+} PrismAbrReason;
+
+/* Adaptive bitrate state (HLS/DASH with several variants) */
+typedef struct PrismAbrInfo {
+    int active;                 /* 1 if the open media has variants to switch between */
+    int variant_count;
+    int current_variant;        /* Index into the variants, ordered by ascending bitrate */
+    int64_t current_bitrate;    /* Advertised bitrate of the current variant, bits per second */
+    double bandwidth;           /* Estimated download bandwidth, bits per second (0 until measured) */
+    double decode_ms;           /* Average video decode + conversion time per frame */
+    int switches;
+    PrismAbrReason last_reason;
+    double last_switch_time;    /* Playback position of the last switch, in seconds */
+} PrismAbrInfo;
+
+typedef struct PrismAbrVariant {
+    int64_t bitrate;            /* Advertised bitrate, bits per second */
+    int width;
+    int height;
+} PrismAbrVariant;
+
+/* Scrub-preview sprite sheet request */
+typedef struct PrismThumbnailOptions {
+    int count;                  /* Thumbnails, evenly spaced over the duration */
+    int tile_width;             /* Thumbnail width in pixels */
+    int tile_height;            /* Thumbnail height, 0 = keep the video's aspect ratio */
+    int columns;                /* Atlas columns, 0 = roughly square atlas */
+    int threads;                /* Worker threads, 0 = the core budget */
+    PrismPixelFormat format;    /* RGBA or BGRA */
+} PrismThumbnailOptions;
+
+/* Generated sprite sheet. Thumbnail i is the tile at column i % columns,
+ * row i / columns; timestamps[i] is the time of the keyframe it shows
+ * (-1 if it could not be decoded, leaving the tile transparent). */
+typedef struct PrismThumbnails {
+    uint8_t* atlas;
+    double* timestamps;
+    int atlas_width;
+    int atlas_height;
+    int atlas_stride;
+    int tile_width;
+    int tile_height;
+    int columns;
+    int count;
+} PrismThumbnails;
+
 /* Callbacks */
 typedef void (*PrismLogCallback)(int level, const char* message);
 typedef void (*PrismVideoFrameCallback)(void* user_data, uint8_t* data, int width, int height, int stride, double pts);
+typedef void (*PrismVideoSizeCallback)(void* user_data, int width, int height);
 typedef void (*PrismAudioSamplesCallback)(void* user_data, float* samples, int num_samples, int channels, double pts);
 
 /* ============================================================================
@@ -111,6 +243,32 @@ PRISM_API const char* prism_get_version(void);
 /* Set global log callback */
 PRISM_API void prism_set_log_callback(PrismLogCallback callback);
 
+/* Set the number of decode and conversion threads shared by all players
+ * (0 = CPU core count). Players without explicit thread counts get an equal
+ * share at Open: a quarter of it for color conversion, the rest for decoding. */
+PRISM_API void prism_set_core_budget(int cores);
+
+/* Get the process-wide core budget */
+PRISM_API int prism_get_core_budget(void);
+
+/* Directory for cached keyframe indexes (NULL or "" disables caching).
+ * Set before opening media; a cached index gives accurate seeking as soon
+ * as a file is reopened. */
+PRISM_API void prism_set_index_cache_dir(const char* path);
+
+/* Cache HTTP(S) progressive files and HLS segments on disk in path, keeping
+ * the directory under max_bytes by evicting least recently used objects
+ * (NULL or max_bytes <= 0 = disabled, the default). Files are cached in
+ * blocks, so replays only fetch what earlier plays did not; fully cached
+ * objects are served without network access. Applies from the next Open. */
+PRISM_API void prism_set_media_cache(const char* path, int64_t max_bytes);
+
+/* Back video frame buffers of 1080p RGBA and larger with huge pages
+ * (default: disabled): reserved huge pages or transparent huge pages on
+ * Linux, large pages on Windows if the process holds SeLockMemoryPrivilege,
+ * otherwise regular pages. Applies to frame sizes first used afterwards. */
+PRISM_API void prism_set_huge_pages(bool enabled);
+
 /* ============================================================================
  * Player Lifecycle
  * ========================================================================== */
@@ -137,15 +295,41 @@ PRISM_API void prism_player_close(PrismPlayer* player);
 /* Start playback */
 PRISM_API int prism_player_play(PrismPlayer* player);
 
+/* Start demuxing and decoding without playing, up to the preroll watermark.
+ * Returns immediately; the first frame is shown by the next updates as a
+ * poster image, and Play then continues from it without a startup delay.
+ * Valid in READY, PAUSED and STOPPED. */
+PRISM_API int prism_player_prepare(PrismPlayer* player);
+
+/* True once Prepare has buffered to the watermark (or the decoder is full)
+ * and, for video, the poster frame has been shown */
+PRISM_API bool prism_player_is_prepared(PrismPlayer* player);
+
+/* Media to buffer ahead during Prepare, in seconds (default 0.5) */
+PRISM_API void prism_player_set_preroll(PrismPlayer* player, double seconds);
+
 /* Pause playback */
 PRISM_API int prism_player_pause(PrismPlayer* player);
 
-/* Stop playback */
+/* Stop playback and rewind. Returns immediately; the rewind is applied in
+ * the background like a seek. */
 PRISM_API int prism_player_stop(PrismPlayer* player);
 
-/* Seek to position in seconds */
+/* Seek to position in seconds (keyframe precision) */
 PRISM_API int prism_player_seek(PrismPlayer* player, double position_seconds);
 
+/* Seek to position in seconds with the given precision. Returns immediately:
+ * the seek is queued and frames from before it are never shown. */
+PRISM_API int prism_player_seek_with_mode(PrismPlayer* player, double position_seconds, PrismSeekMode mode);
+
+/* Serial of the most recently posted Seek/Stop. Read it after posting and
+ * wait for prism_player_get_completed_serial to reach it to know the
+ * pipeline has moved to the new position. */
+PRISM_API uint32_t prism_player_get_command_serial(PrismPlayer* player);
+
+/* Serial of the most recent Seek/Stop the pipeline has applied */
+PRISM_API uint32_t prism_player_get_completed_serial(PrismPlayer* player);
+
 /* ============================================================================
  * State and Info
  * ========================================================================== */
@@ -171,6 +355,15 @@ PRISM_API bool prism_player_get_video_info(PrismPlayer* player, PrismVideoInfo*
 /* Get audio info (returns false if no audio) */
 PRISM_API bool prism_player_get_audio_info(PrismPlayer* player, PrismAudioInfo* info);
 
+/* Get playback pipeline statistics (returns false if player is NULL) */
+PRISM_API bool prism_player_get_stats(PrismPlayer* player, PrismPlayerStats* stats);
+
+/* Get adaptive bitrate state (returns false if player is NULL) */
+PRISM_API bool prism_player_get_abr_info(PrismPlayer* player, PrismAbrInfo* info);
+
+/* Get one of the variants ABR switches between (index < variant_count) */
+PRISM_API bool prism_player_get_abr_variant(PrismPlayer* player, int index, PrismAbrVariant* variant);
+
 /* Get current playback position in seconds */
 PRISM_API double prism_player_get_position(PrismPlayer* player);
 
@@ -185,19 +378,31 @@ PRISM_API bool prism_player_is_live(PrismPlayer* player);
  * ========================================================================== */
 
 /* Update decoder - call this each frame from Unity
- * Returns number of frames decoded, or negative on error */
+ * Returns number of frames decoded, or negative on error
+ * update, get_video_frame and copy_video_frame must all be called from the
+ * same thread (the frame queue is lock-free with a single consumer) */
 PRISM_API int prism_player_update(PrismPlayer* player, double delta_time);
 
 /* Get the latest decoded video frame
  * Returns pointer to RGBA pixel data, or NULL if no frame available
+ * For planar output formats this is the Y plane; use get_video_planes instead
+ * Rows are out_stride bytes apart: width * 4 for converted frames, possibly
+ * more for decoder frames passed through unconverted
  * The pointer is valid until the next call to update or close */
 PRISM_API uint8_t* prism_player_get_video_frame(PrismPlayer* player, int* out_width, int* out_height, int* out_stride);
 
+/* Get the latest decoded video frame as separate planes plus colorimetry
+ * Returns false if no new frame is available (consumes it like get_video_frame)
+ * The plane pointers are valid until the next call to update or close */
+PRISM_API bool prism_player_get_video_planes(PrismPlayer* player, PrismVideoPlanes* planes);
+
 /* Get video frame timestamp (presentation time) */
 PRISM_API double prism_player_get_video_pts(PrismPlayer* player);
 
 /* Copy video frame to provided buffer
- * Buffer must be at least width * height * 4 bytes (RGBA) */
+ * Buffer must be at least width * height * 4 bytes (RGBA)
+ * Planar formats are written as contiguous Y, U, V (YUV420P, chroma stride dest_stride / 2)
+ * or Y, UV (NV12, chroma stride dest_stride): dest_stride * height * 3 / 2 bytes */
 PRISM_API int prism_player_copy_video_frame(PrismPlayer* player, uint8_t* dest_buffer, int dest_stride);
 
 /* ============================================================================
@@ -206,7 +411,8 @@ PRISM_API int prism_player_copy_video_frame(PrismPlayer* player, uint8_t* dest_b
 
 /* Get decoded audio samples
  * Returns number of samples available, samples are interleaved floats [-1, 1]
- * Copies up to max_samples to the buffer */
+ * Copies up to max_samples to the buffer. Never blocks, so it may be called
+ * from a real-time audio thread (one thread at a time) */
 PRISM_API int prism_player_get_audio_samples(PrismPlayer* player, float* buffer, int max_samples);
 
 /* Get audio sample rate (output rate, not source) */
@@ -222,9 +428,24 @@ PRISM_API int prism_player_get_audio_channels(PrismPlayer* player);
  * Settings
  * ========================================================================== */
 
-/* Set output pixel format (default RGBA) */
+/* Set output pixel format (default RGBA, call before Open)
+ * YUV420P/NV12 frames that the decoder already produces in that layout are
+ * passed through without conversion */
 PRISM_API void prism_player_set_pixel_format(PrismPlayer* player, PrismPixelFormat format);
 
+/* Scale video to fit inside width x height as part of the color conversion,
+ * keeping the aspect ratio and never enlarging (0 x 0 = source size, the
+ * default). Use the on-screen size so only displayed pixels are converted
+ * and copied. Can be changed during playback; frames decoded afterwards
+ * use the new size. */
+PRISM_API void prism_player_set_output_size(PrismPlayer* player, int width, int height);
+
+/* Let decoders that support it (codec lowres, e.g. MJPEG) decode at 1/2,
+ * 1/4 or 1/8 of the source size when the output size is that much smaller
+ * (default: disabled). Uses the output size at Open; applies from the
+ * next Open. */
+PRISM_API void prism_player_set_lowres(PrismPlayer* player, bool enabled);
+
 /* Set looping */
 PRISM_API void prism_player_set_loop(PrismPlayer* player, bool loop);
 
@@ -246,6 +467,56 @@ PRISM_API float prism_player_get_volume(PrismPlayer* player);
 /* Enable/disable hardware acceleration */
 PRISM_API void prism_player_set_hardware_acceleration(PrismPlayer* player, bool enabled);
 
+/* Set video decoder threading (call before Open)
+ * thread_count 0 = this player's share of the core budget less its conversion threads */
+PRISM_API void prism_player_set_decode_threads(PrismPlayer* player, PrismThreadMode mode, int thread_count);
+
+/* Get the number of threads the open video decoder is using */
+PRISM_API int prism_player_get_decode_threads(PrismPlayer* player);
+
+/* Set the Open profile (default: PRISM_OPEN_PROFILE_DEFAULT). Applies from
+ * the next Open; probesize/analyzeduration in Open options still override. */
+PRISM_API void prism_player_set_open_profile(PrismPlayer* player, PrismOpenProfile profile);
+
+/* Low-latency live playback (applies from the next Open, live streams only).
+ * Demuxing stops buffering, and playback runs at 0.95 - 1.05x (audio
+ * resampled to match) to hold target_latency seconds behind the newest
+ * received frame. Frames are only dropped once they fall more than a second
+ * past the target. target_latency <= 0 = 1 second. */
+PRISM_API void prism_player_set_low_latency(PrismPlayer* player, bool enabled, double target_latency);
+
+/* Set color conversion threads (call before Open). Each frame is split into
+ * horizontal slices converted in parallel.
+ * thread_count 0 = a quarter of this player's share of the core budget, 1 = no threading */
+PRISM_API void prism_player_set_convert_threads(PrismPlayer* player, int thread_count);
+
+/* Get the number of slice threads the open color conversion is using */
+PRISM_API int prism_player_get_convert_threads(PrismPlayer* player);
+
+/* Build a keyframe index in the background for local files whose container
+ * index is missing or sparse (default: enabled). Applies from the next Open. */
+PRISM_API void prism_player_set_keyframe_index(PrismPlayer* player, bool enabled);
+
+/* Read progressive HTTP(S) sources through a read-ahead buffer filled by a
+ * dedicated I/O thread (default 8 MB, minimum 1 MB, 0 = read directly).
+ * Seeks within the buffered range are served from memory. Applies from
+ * the next Open. */
+PRISM_API void prism_player_set_read_ahead(PrismPlayer* player, int64_t size_bytes);
+
+/* Select how local files are read (default: PRISM_FILE_BACKEND_DEFAULT).
+ * Applies from the next Open; demux_read_ms / demux_bytes in the stats
+ * compare backends. */
+PRISM_API void prism_player_set_file_backend(PrismPlayer* player, PrismFileBackend backend);
+
+/* Adaptive bitrate for HLS/DASH with several variants (default: enabled).
+ * Starts on the lowest bitrate and switches at segment boundaries from
+ * measured segment download throughput and decode headroom. Only the
+ * current variant is downloaded. Video is output at the largest variant's
+ * size (fitted to the output size), so switching does not change the frame
+ * size; variants above the first one covering the output size are not
+ * used. Applies from the next Open. */
+PRISM_API void prism_player_set_abr(PrismPlayer* player, bool enabled);
+
 /* ============================================================================
  * Callbacks (alternative to polling)
  * ========================================================================== */
@@ -253,9 +524,30 @@ PRISM_API void prism_player_set_hardware_acceleration(PrismPlayer* player, bool
 /* Set callback for video frames */
 PRISM_API void prism_player_set_video_callback(PrismPlayer* player, PrismVideoFrameCallback callback, void* user_data);
 
+/* Set callback for video size changes. The size follows the stream, which
+ * may change it mid-stream (new resolution, pixel format or variant); the
+ * pipeline reconfigures without reopening. Called from Update when the
+ * first frame of a new size is displayed (including the first frame). */
+PRISM_API void prism_player_set_video_size_callback(PrismPlayer* player, PrismVideoSizeCallback callback, void* user_data);
+
 /* Set callback for audio samples */
 PRISM_API void prism_player_set_audio_callback(PrismPlayer* player, PrismAudioSamplesCallback callback, void* user_data);
 
+/* ============================================================================
+ * Thumbnails
+ * ========================================================================== */
+
+/* Generate a sprite sheet of scrub-preview thumbnails for a VOD file or
+ * stream, independent of any player. Only keyframes are decoded, at reduced
+ * resolution where the codec supports it, across a pool of worker threads.
+ * HLS I-frame playlists are used when the master playlist has them.
+ * Blocks until done; call from a background thread. Returns NULL on failure.
+ * Free with prism_thumbnails_free. */
+PRISM_API PrismThumbnails* prism_thumbnails_generate(const char* url, const PrismThumbnailOptions* options);
+
+/* Free a sprite sheet from prism_thumbnails_generate */
+PRISM_API void prism_thumbnails_free(PrismThumbnails* thumbnails);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,735 @@
+/*
+ * Prism FFmpeg Native Plugin - Media cache
+ *
+ * Each object is two files named by a hash of its URL: <key>.pcd holds the
+ * data at its original offsets (blocks not fetched yet are holes) and
+ * <key>.pcm a header, the URL and a bitmap of the blocks present. The
+ * metadata file is rewritten on every close, so its modification time is
+ * the object's last use for LRU eviction. An open object owns its files:
+ * a second open of the same URL meanwhile bypasses the cache.
+ *
+ * FFmpeg's HTTP protocol does not expose ETag or Last-Modified, so an
+ * object is validated by its length and MIME type, and only when the
+ * network is needed anyway: a fully cached object is trusted as-is. One
+ * that changed is cached again from scratch, or read uncached if its new
+ * length is unknown.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#include "prism_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <libavutil/error.h>
+#include <libavutil/log.h>
+#include <libavutil/mem.h>
+#include <libavutil/opt.h>
+#include <libavutil/time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <pthread.h>
+#endif
+
+#define CACHE_MAGIC "PRISMCAC"
+#define CACHE_VERSION 1
+#define CACHE_BLOCK_SIZE (256 * 1024)
+#define CACHE_AVIO_BUFFER (64 * 1024)
+
+typedef struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    int64_t size;
+    uint32_t block_count;
+    uint32_t url_length;        /* URL follows the header, then the block bitmap */
+    char mime_type[64];
+} CacheHeader;
+
+typedef struct CacheObject {
+    char* url;
+    char dir[1024];
+    char meta_path[1100];
+    char data_path[1100];
+    FILE* data;
+
+    int64_t size;
+    char mime_type[64];
+    uint8_t* bitmap;
+    uint32_t block_count;
+    uint32_t blocks_cached;
+    bool stale;                 /* Changed to unknown length: read uncached, deleted on close */
+
+    int64_t pos;
+    uint8_t* block;             /* Block the reader is in */
+    int64_t block_index;        /* -1 = none */
+    int block_length;
+
+    AVIOContext* inner;         /* Network, opened on the first missing block */
+    AVDictionary* options;      /* Protocol options for that open */
+    AVIOInterruptCB interrupt;
+    int64_t network_bytes;      /* Fetched from the network, for throughput metering */
+    int64_t network_us;         /* Time spent opening, seeking and reading it */
+
+    struct CacheObject* next;   /* In g_open_objects */
+} CacheObject;
+
+static char g_cache_dir[1024] = "";
+static int64_t g_cache_max_bytes = 0;
+static CacheObject* g_open_objects = NULL;  /* Objects that own their files until closed */
+#ifdef _WIN32
+static SRWLOCK g_cache_lock = SRWLOCK_INIT;
+#else
+static pthread_mutex_t g_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void lock_cache(void) {
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&g_cache_lock);
+#else
+    pthread_mutex_lock(&g_cache_lock);
+#endif
+}
+
+static void unlock_cache(void) {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(&g_cache_lock);
+#else
+    pthread_mutex_unlock(&g_cache_lock);
+#endif
+}
+
+static int file_seek(FILE* file, int64_t pos) {
+#ifdef _WIN32
+    return _fseeki64(file, pos, SEEK_SET);
+#else
+    return fseeko(file, (off_t)pos, SEEK_SET);
+#endif
+}
+
+static bool file_info(const char* path, int64_t* mtime, int64_t* size) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(path, &info) != 0) {
+        return false;
+    }
+#else
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return false;
+    }
+#endif
+    *mtime = (int64_t)info.st_mtime;
+    *size = (int64_t)info.st_size;
+    return true;
+}
+
+/* FNV-1a */
+static uint64_t hash_url(const char* url) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const uint8_t* p = (const uint8_t*)url; *p; p++) {
+        hash ^= *p;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool has_block(const CacheObject* obj, int64_t index) {
+    return (obj->bitmap[index >> 3] >> (index & 7)) & 1;
+}
+
+static void set_block(CacheObject* obj, int64_t index, bool present) {
+    if (has_block(obj, index) == present) {
+        return;
+    }
+    obj->bitmap[index >> 3] ^= (uint8_t)(1 << (index & 7));
+    obj->blocks_cached += present ? 1 : -1;
+}
+
+static uint32_t count_blocks(int64_t size) {
+    return (uint32_t)((size + CACHE_BLOCK_SIZE - 1) / CACHE_BLOCK_SIZE);
+}
+
+/* True if an open object uses data_path (cache lock held) */
+static bool is_open(const char* data_path) {
+    for (CacheObject* obj = g_open_objects; obj; obj = obj->next) {
+        if (strcmp(obj->data_path, data_path) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Release obj's files to the next open (cache lock held) */
+static void unregister_object(CacheObject* obj) {
+    for (CacheObject** link = &g_open_objects; *link; link = &(*link)->next) {
+        if (*link == obj) {
+            *link = obj->next;
+            return;
+        }
+    }
+}
+
+/* ============================================================================
+ * Metadata
+ * ========================================================================== */
+
+static bool load_meta(CacheObject* obj) {
+    FILE* file = fopen(obj->meta_path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    CacheHeader header;
+    size_t url_length = strlen(obj->url);
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == CACHE_VERSION &&
+        header.block_size == CACHE_BLOCK_SIZE &&
+        header.size > 0 && header.block_count == count_blocks(header.size) &&
+        header.url_length == url_length;
+
+    /* Different URL with the same hash */
+    char* url = ok ? (char*)av_malloc(url_length) : NULL;
+    ok = ok && url && fread(url, 1, url_length, file) == url_length &&
+        memcmp(url, obj->url, url_length) == 0;
+    av_free(url);
+
+    size_t bitmap_size = ok ? (header.block_count + 7) / 8 : 0;
+    uint8_t* bitmap = ok ? (uint8_t*)av_mallocz(bitmap_size) : NULL;
+    ok = ok && bitmap && fread(bitmap, 1, bitmap_size, file) == bitmap_size;
+    fclose(file);
+
+    if (!ok) {
+        av_free(bitmap);
+        return false;
+    }
+
+    obj->size = header.size;
+    obj->block_count = header.block_count;
+    obj->bitmap = bitmap;
+    obj->blocks_cached = 0;
+    for (uint32_t i = 0; i < obj->block_count; i++) {
+        obj->blocks_cached += has_block(obj, i);
+    }
+    memcpy(obj->mime_type, header.mime_type, sizeof(obj->mime_type));
+    obj->mime_type[sizeof(obj->mime_type) - 1] = '\0';
+    return true;
+}
+
+/* Written to a temporary file, then renamed into place */
+static bool save_meta(const CacheObject* obj) {
+    char temp_path[1200];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", obj->meta_path);
+
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.block_size = CACHE_BLOCK_SIZE;
+    header.size = obj->size;
+    header.block_count = obj->block_count;
+    header.url_length = (uint32_t)strlen(obj->url);
+    memcpy(header.mime_type, obj->mime_type, sizeof(header.mime_type));
+
+    size_t bitmap_size = (obj->block_count + 7) / 8;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(obj->url, 1, header.url_length, file) == header.url_length &&
+        fwrite(obj->bitmap, 1, bitmap_size, file) == bitmap_size;
+    ok = (fclose(file) == 0) && ok;
+
+    /* rename() does not replace an existing file on Windows */
+    remove(obj->meta_path);
+    if (!ok || rename(temp_path, obj->meta_path) != 0) {
+        remove(temp_path);
+        return false;
+    }
+    return true;
+}
+
+/* ============================================================================
+ * Eviction
+ * ========================================================================== */
+
+typedef struct CacheEntry {
+    char key[17];
+    int64_t mtime;
+    int64_t bytes;
+} CacheEntry;
+
+static int compare_entries(const void* a, const void* b) {
+    int64_t ma = ((const CacheEntry*)a)->mtime;
+    int64_t mb = ((const CacheEntry*)b)->mtime;
+    return (ma > mb) - (ma < mb);
+}
+
+static bool add_entry(CacheEntry** entries, int* count, int* capacity, const char* dir, const char* name) {
+    size_t length = strlen(name);
+    if (length != 20 || strcmp(name + 16, ".pcm") != 0) {
+        return true;
+    }
+
+    if (*count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : 64;
+        CacheEntry* array = (CacheEntry*)av_realloc_array(*entries, grown, sizeof(CacheEntry));
+        if (!array) {
+            return false;
+        }
+        *entries = array;
+        *capacity = grown;
+    }
+
+    CacheEntry* entry = &(*entries)[*count];
+    memcpy(entry->key, name, 16);
+    entry->key[16] = '\0';
+
+    char path[1100];
+    int64_t meta_size = 0;
+    int64_t data_size = 0;
+    int64_t data_mtime = 0;
+    snprintf(path, sizeof(path), "%s/%s.pcm", dir, entry->key);
+    if (!file_info(path, &entry->mtime, &meta_size)) {
+        return true;
+    }
+    snprintf(path, sizeof(path), "%s/%s.pcd", dir, entry->key);
+    file_info(path, &data_mtime, &data_size);
+    entry->bytes = meta_size + data_size;
+    (*count)++;
+    return true;
+}
+
+/* Delete least recently used objects until the directory fits the limit
+ * (cache lock held). Open objects are skipped; their close trims again. */
+static void trim_cache(const char* dir, int64_t max_bytes) {
+    CacheEntry* entries = NULL;
+    int count = 0;
+    int capacity = 0;
+
+#ifdef _WIN32
+    char pattern[1100];
+    snprintf(pattern, sizeof(pattern), "%s/*.pcm", dir);
+    WIN32_FIND_DATAA found;
+    HANDLE find = FindFirstFileA(pattern, &found);
+    if (find == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    do {
+        if (!add_entry(&entries, &count, &capacity, dir, found.cFileName)) {
+            break;
+        }
+    } while (FindNextFileA(find, &found));
+    FindClose(find);
+#else
+    DIR* listing = opendir(dir);
+    if (!listing) {
+        return;
+    }
+    struct dirent* item;
+    while ((item = readdir(listing)) != NULL) {
+        if (!add_entry(&entries, &count, &capacity, dir, item->d_name)) {
+            break;
+        }
+    }
+    closedir(listing);
+#endif
+
+    int64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += entries[i].bytes;
+    }
+
+    if (total > max_bytes) {
+        qsort(entries, count, sizeof(CacheEntry), compare_entries);
+        for (int i = 0; i < count && total > max_bytes; i++) {
+            char path[1100];
+            snprintf(path, sizeof(path), "%s/%s.pcd", dir, entries[i].key);
+            if (is_open(path)) {
+                continue;
+            }
+            remove(path);
+            snprintf(path, sizeof(path), "%s/%s.pcm", dir, entries[i].key);
+            remove(path);
+            total -= entries[i].bytes;
+        }
+    }
+    av_free(entries);
+}
+
+/* ============================================================================
+ * Cached AVIOContext
+ * ========================================================================== */
+
+/* open_network found the object changed on the server and reset it */
+#define OBJECT_RESET 1
+
+/* Describe the object by the response just opened: no blocks cached and an
+ * empty data file. The object is registered as open, so no other context
+ * has this file; whatever it holds is left over from an unusable entry. */
+static int start_object(CacheObject* obj) {
+    obj->block_count = count_blocks(obj->size);
+    obj->bitmap = (uint8_t*)av_mallocz((obj->block_count + 7) / 8);
+    obj->blocks_cached = 0;
+    lock_cache();
+    if (obj->data) {
+        fclose(obj->data);
+    }
+    obj->data = fopen(obj->data_path, "w+b");
+    unlock_cache();
+    return obj->bitmap ? 0 : AVERROR(ENOMEM);
+}
+
+static int open_network(CacheObject* obj, AVDictionary** options) {
+    int ret = avio_open2(&obj->inner, obj->url, AVIO_FLAG_READ, &obj->interrupt, options);
+    if (ret < 0) {
+        return ret;
+    }
+
+    char* mime_type = NULL;
+    if (av_opt_get(obj->inner, "mime_type", AV_OPT_SEARCH_CHILDREN, (uint8_t**)&mime_type) < 0) {
+        mime_type = NULL;
+    }
+
+    /* First open of a new object: it is described by this response. Later
+     * opens check the object has not changed since. */
+    int64_t size = avio_size(obj->inner);
+    bool changed = obj->bitmap && (size != obj->size ||
+        (mime_type && obj->mime_type[0] && strcmp(mime_type, obj->mime_type) != 0));
+    if (!obj->bitmap || changed) {
+        obj->size = size;
+        snprintf(obj->mime_type, sizeof(obj->mime_type), "%s", mime_type ? mime_type : "");
+    }
+    av_free(mime_type);
+    if (!changed) {
+        return 0;
+    }
+
+    /* The cached blocks belong to the old version: start over on this one */
+    av_log(NULL, AV_LOG_INFO, "Media cache: %s changed on the server, caching it again\n", obj->url);
+    av_freep(&obj->bitmap);
+    obj->block_index = -1;
+    if (size <= 0 || start_object(obj) < 0) {
+        av_freep(&obj->bitmap);
+        obj->blocks_cached = 0;
+        obj->stale = true;
+    }
+    return OBJECT_RESET;
+}
+
+/* Get one block from the network into obj->block */
+static int receive_block(CacheObject* obj, int64_t start, int length) {
+    if (!obj->inner) {
+        AVDictionary* options = NULL;
+        av_dict_copy(&options, obj->options, 0);
+        int ret = open_network(obj, &options);
+        av_dict_free(&options);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    if (avio_tell(obj->inner) != start) {
+        int64_t pos = avio_seek(obj->inner, start, SEEK_SET);
+        if (pos < 0) {
+            return (int)pos;
+        }
+    }
+
+    int ret = avio_read(obj->inner, obj->block, length);
+    if (ret < 0) {
+        return ret;
+    }
+    return (ret == length) ? 0 : AVERROR(EIO);
+}
+
+/* Get one block from the network into obj->block and the data file */
+static int fetch_block(CacheObject* obj, int64_t start, int length) {
+    int64_t fetch_start = av_gettime_relative();
+    int ret = receive_block(obj, start, length);
+    obj->network_us += av_gettime_relative() - fetch_start;
+    if (ret != 0) {
+        return ret;
+    }
+    obj->network_bytes += length;
+
+    /* A failed write only costs the cache entry, not the read */
+    int64_t index = start / CACHE_BLOCK_SIZE;
+    if (obj->data && file_seek(obj->data, start) == 0 &&
+        fwrite(obj->block, 1, length, obj->data) == (size_t)length) {
+        set_block(obj, index, true);
+    }
+    return 0;
+}
+
+static int load_block(CacheObject* obj, int64_t index) {
+    int64_t start = index * CACHE_BLOCK_SIZE;
+    int length = (int)FFMIN((int64_t)CACHE_BLOCK_SIZE, obj->size - start);
+
+    bool hit = false;
+    if (has_block(obj, index)) {
+        hit = obj->data && file_seek(obj->data, start) == 0 &&
+            fread(obj->block, 1, length, obj->data) == (size_t)length;
+        if (!hit) {
+            set_block(obj, index, false);   /* Data file lost or truncated */
+        }
+    }
+    if (!hit) {
+        obj->block_index = -1;
+        int ret = fetch_block(obj, start, length);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    obj->block_index = index;
+    obj->block_length = length;
+    return 0;
+}
+
+/* Read a stale object straight from the network */
+static int read_uncached(CacheObject* obj, uint8_t* buf, int buf_size) {
+    if (avio_tell(obj->inner) != obj->pos) {
+        int64_t pos = avio_seek(obj->inner, obj->pos, SEEK_SET);
+        if (pos < 0) {
+            return (int)pos;
+        }
+    }
+
+    int64_t fetch_start = av_gettime_relative();
+    int ret = avio_read_partial(obj->inner, buf, buf_size);
+    obj->network_us += av_gettime_relative() - fetch_start;
+    if (ret <= 0) {
+        return ret < 0 ? ret : AVERROR_EOF;
+    }
+    obj->network_bytes += ret;
+    obj->pos += ret;
+    return ret;
+}
+
+static int cache_read(void* opaque, uint8_t* buf, int buf_size) {
+    CacheObject* obj = (CacheObject*)opaque;
+    if (obj->stale) {
+        return read_uncached(obj, buf, buf_size);
+    }
+    if (obj->pos >= obj->size) {
+        return AVERROR_EOF;
+    }
+
+    int64_t index = obj->pos / CACHE_BLOCK_SIZE;
+    if (index != obj->block_index) {
+        int ret = load_block(obj, index);
+        if (ret == OBJECT_RESET) {
+            /* Go on reading the new version; the network is open now, so
+             * this does not recurse again */
+            return cache_read(opaque, buf, buf_size);
+        }
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    int offset = (int)(obj->pos - index * CACHE_BLOCK_SIZE);
+    int size = FFMIN(buf_size, obj->block_length - offset);
+    memcpy(buf, obj->block + offset, size);
+    obj->pos += size;
+    return size;
+}
+
+static int64_t cache_seek(void* opaque, int64_t offset, int whence) {
+    CacheObject* obj = (CacheObject*)opaque;
+    int64_t size = obj->stale ? avio_size(obj->inner) : obj->size;  /* < 0 if unknown */
+
+    int64_t target;
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE: return size;
+        case SEEK_SET:    target = offset; break;
+        case SEEK_CUR:    target = obj->pos + offset; break;
+        case SEEK_END:    target = size + offset; break;
+        default:          return AVERROR(EINVAL);
+    }
+    if (target < 0 || (size >= 0 && target > size) ||
+        (size < 0 && (whence & ~AVSEEK_FORCE) == SEEK_END)) {
+        return AVERROR(EINVAL);
+    }
+    obj->pos = target;
+    return target;
+}
+
+static void free_object(CacheObject* obj) {
+    lock_cache();
+    unregister_object(obj);
+    unlock_cache();
+
+    avio_closep(&obj->inner);
+    if (obj->data) {
+        fclose(obj->data);
+    }
+    av_dict_free(&obj->options);
+    av_free(obj->bitmap);
+    av_free(obj->block);
+    av_free(obj->url);
+    av_free(obj);
+}
+
+/* ============================================================================
+ * Public API
+ * ========================================================================== */
+
+void prism_cache_configure(const char* dir, int64_t max_bytes) {
+    lock_cache();
+    if (dir && max_bytes > 0) {
+        snprintf(g_cache_dir, sizeof(g_cache_dir), "%s", dir);
+        g_cache_max_bytes = max_bytes;
+    } else {
+        g_cache_dir[0] = '\0';
+        g_cache_max_bytes = 0;
+    }
+    unlock_cache();
+}
+
+bool prism_cache_accepts(const char* url) {
+    lock_cache();
+    bool enabled = g_cache_dir[0] != '\0';
+    unlock_cache();
+    return enabled && (strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0);
+}
+
+int prism_cache_open(AVIOContext** pb, const char* url, const AVIOInterruptCB* interrupt,
+    AVDictionary** options) {
+    *pb = NULL;
+    if (!prism_cache_accepts(url)) {
+        return avio_open2(pb, url, AVIO_FLAG_READ, interrupt, options);
+    }
+
+    CacheObject* obj = (CacheObject*)av_mallocz(sizeof(CacheObject));
+    if (!obj) {
+        return AVERROR(ENOMEM);
+    }
+    obj->url = av_strdup(url);
+    obj->block = (uint8_t*)av_malloc(CACHE_BLOCK_SIZE);
+    obj->block_index = -1;
+    if (interrupt) {
+        obj->interrupt = *interrupt;
+    }
+    if (options && *options) {
+        av_dict_copy(&obj->options, *options, 0);
+    }
+    if (!obj->url || !obj->block) {
+        free_object(obj);
+        return AVERROR(ENOMEM);
+    }
+
+    lock_cache();
+    snprintf(obj->dir, sizeof(obj->dir), "%s", g_cache_dir);
+    uint64_t key = hash_url(url);
+    snprintf(obj->meta_path, sizeof(obj->meta_path), "%s/%016llx.pcm", obj->dir, (unsigned long long)key);
+    snprintf(obj->data_path, sizeof(obj->data_path), "%s/%016llx.pcd", obj->dir, (unsigned long long)key);
+
+    /* Another player has the object open: its data file and bitmap are in
+     * use until it closes, so this one reads straight from the network */
+    if (is_open(obj->data_path)) {
+        unlock_cache();
+        free_object(obj);
+        return avio_open2(pb, url, AVIO_FLAG_READ, interrupt, options);
+    }
+    obj->next = g_open_objects;
+    g_open_objects = obj;
+
+    bool cached = load_meta(obj);
+    if (cached && !(obj->data = fopen(obj->data_path, "r+b"))) {
+        av_freep(&obj->bitmap);
+        cached = false;
+    }
+    unlock_cache();
+
+    /* A known object only goes to the network for blocks it is missing */
+    if (!cached) {
+        int ret = open_network(obj, options);
+        if (ret < 0) {
+            free_object(obj);
+            return ret;
+        }
+
+        /* Unknown length (chunked transfer, live): read directly */
+        if (obj->size <= 0) {
+            *pb = obj->inner;
+            obj->inner = NULL;
+            free_object(obj);
+            return 0;
+        }
+
+        ret = start_object(obj);
+        if (ret < 0) {
+            free_object(obj);
+            return ret;
+        }
+    }
+
+    uint8_t* buffer = (uint8_t*)av_malloc(CACHE_AVIO_BUFFER);
+    if (buffer) {
+        *pb = avio_alloc_context(buffer, CACHE_AVIO_BUFFER, 0, obj, cache_read, NULL, cache_seek);
+    }
+    if (!*pb) {
+        av_free(buffer);
+        free_object(obj);
+        return AVERROR(ENOMEM);
+    }
+    (*pb)->seekable = AVIO_SEEKABLE_NORMAL;
+    return 0;
+}
+
+bool prism_cache_is_cached_context(const AVIOContext* pb) {
+    return pb && pb->read_packet == cache_read;
+}
+
+void prism_cache_network_usage(const AVIOContext* pb, int64_t* bytes, int64_t* busy_us) {
+    const CacheObject* obj = (const CacheObject*)pb->opaque;
+    *bytes = obj->network_bytes;
+    *busy_us = obj->network_us;
+}
+
+void prism_cache_close(AVIOContext** ppb) {
+    AVIOContext* pb = *ppb;
+    if (!pb) {
+        return;
+    }
+    if (!prism_cache_is_cached_context(pb)) {
+        avio_closep(ppb);
+        return;
+    }
+    *ppb = NULL;
+
+    CacheObject* obj = (CacheObject*)pb->opaque;
+    av_freep(&pb->buffer);
+    avio_context_free(&pb);
+
+    if (obj->data) {
+        fclose(obj->data);
+        obj->data = NULL;
+    }
+
+    lock_cache();
+    if (obj->stale || obj->blocks_cached == 0) {
+        remove(obj->data_path);
+        remove(obj->meta_path);
+    } else {
+        save_meta(obj);
+    }
+    unregister_object(obj);
+    if (g_cache_dir[0] && strcmp(g_cache_dir, obj->dir) == 0) {
+        trim_cache(obj->dir, g_cache_max_bytes);
+    }
+    unlock_cache();
+
+    free_object(obj);
+}
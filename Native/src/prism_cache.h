@@ -0,0 +1,48 @@
+/*
+ * Prism FFmpeg Native Plugin - Media cache
+ *
+ * Persistent on-disk cache for HTTP(S) objects: progressive files and HLS
+ * segments. Objects are stored in fixed-size blocks keyed by URL, so a
+ * partly played file only fetches the ranges it is missing, and a fully
+ * cached object is served without touching the network. The cache
+ * directory is kept under a size limit by evicting least recently used
+ * objects.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#ifndef PRISM_CACHE_H
+#define PRISM_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <libavformat/avio.h>
+#include <libavutil/dict.h>
+
+/* Enable the cache in dir, limited to max_bytes (NULL dir or max_bytes <= 0
+ * disables it). Affects objects opened afterwards. */
+void prism_cache_configure(const char* dir, int64_t max_bytes);
+
+/* True if url would be cached (cache enabled, HTTP or HTTPS) */
+bool prism_cache_accepts(const char* url);
+
+/* Drop-in for avio_open2 for reading. Cacheable objects of known size get a
+ * cache-backed context; anything else, and an object another context has
+ * open, is opened directly. Either way the context must be closed with
+ * prism_cache_close. */
+int prism_cache_open(AVIOContext** pb, const char* url, const AVIOInterruptCB* interrupt,
+    AVDictionary** options);
+
+/* True if pb came from prism_cache_open's cache path */
+bool prism_cache_is_cached_context(const AVIOContext* pb);
+
+/* Bytes a cache-path context has fetched from the network, and the time
+ * spent fetching them. Blocks served from disk count towards neither. */
+void prism_cache_network_usage(const AVIOContext* pb, int64_t* bytes, int64_t* busy_us);
+
+/* Close a context from prism_cache_open, saving what was fetched and
+ * trimming the cache to its limit. NULL-safe; sets *pb to NULL. */
+void prism_cache_close(AVIOContext** pb);
+
+#endif /* PRISM_CACHE_H */
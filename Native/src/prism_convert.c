@@ -0,0 +1,474 @@
+/*
+ * Prism FFmpeg Native Plugin - YUV to RGB conversion kernels
+ *
+ * All implementations use the same 16-bit fixed-point arithmetic, so the
+ * SIMD kernels are bit-exact with prism_yuv_row_c. Chroma is upsampled by
+ * pixel replication, as swscale's unscaled YUV to RGB path does.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#include "prism_convert.h"
+
+#include <math.h>
+
+#include <libavutil/cpu.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define PRISM_YUV_X86 1
+    #include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #define PRISM_YUV_NEON 1
+    #include <arm_neon.h>
+#endif
+
+/* GCC and Clang compile each kernel for its own instruction set; MSVC
+ * allows intrinsics anywhere */
+#if defined(__GNUC__) || defined(__clang__)
+    #define PRISM_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define PRISM_TARGET(isa)
+#endif
+
+/* ============================================================================
+ * Coefficients
+ * ========================================================================== */
+
+static int16_t to_q13(double value) {
+    return (int16_t)lrint(value * 8192.0);
+}
+
+/* kr, kb: luma weights of the color matrix (BT.601: 0.299, 0.114) */
+static void init_coeffs(PrismYuvCoeffs* coeffs, double kr, double kb, bool full_range) {
+    double kg = 1.0 - kr - kb;
+    double y_scale = full_range ? 1.0 : 255.0 / 219.0;
+    double c_scale = full_range ? 1.0 : 255.0 / 224.0;
+
+    coeffs->y_offset = full_range ? 0 : 16;
+    coeffs->y_scale = to_q13(y_scale);
+    coeffs->r_v = to_q13(2.0 * (1.0 - kr) * c_scale);
+    coeffs->g_u = to_q13(2.0 * kb * (1.0 - kb) / kg * c_scale);
+    coeffs->g_v = to_q13(2.0 * kr * (1.0 - kr) / kg * c_scale);
+    coeffs->b_u = to_q13(2.0 * (1.0 - kb) * c_scale);
+}
+
+/* ============================================================================
+ * Reference Implementation
+ * ========================================================================== */
+
+/* (a * b + 2^14) >> 15, as pmulhrsw / vqrdmulh compute it */
+static inline int mulhrs(int a, int b) {
+    return (a * b + 0x4000) >> 15;
+}
+
+static inline uint8_t clamp_u8(int value) {
+    return (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+void prism_yuv_row_c(const uint8_t* y, const uint8_t* u, const uint8_t* v, int uv_step,
+    uint8_t* dst, int width, const PrismYuvCoeffs* coeffs, bool bgra) {
+    int r_index = bgra ? 2 : 0;
+    int b_index = bgra ? 0 : 2;
+
+    for (int x = 0; x < width; x++) {
+        int cu = (u[(x >> 1) * uv_step] - 128) * 128;
+        int cv = (v[(x >> 1) * uv_step] - 128) * 128;
+        int luma = mulhrs((y[x] - coeffs->y_offset) * 128, coeffs->y_scale) + 16;
+
+        int r = luma + mulhrs(cv, coeffs->r_v);
+        int g = luma - (mulhrs(cu, coeffs->g_u) + mulhrs(cv, coeffs->g_v));
+        int b = luma + mulhrs(cu, coeffs->b_u);
+
+        dst[x * 4 + r_index] = clamp_u8(r >> 5);
+        dst[x * 4 + 1] = clamp_u8(g >> 5);
+        dst[x * 4 + b_index] = clamp_u8(b >> 5);
+        dst[x * 4 + 3] = 255;
+    }
+}
+
+/* ============================================================================
+ * SSE4.1 (16 pixels per iteration)
+ * ========================================================================== */
+
+#ifdef PRISM_YUV_X86
+
+/* 8 pixels: luma (16-bit lanes) plus per-pixel chroma terms -> 32 bytes */
+PRISM_TARGET("sse4.1")
+static inline void store8_sse41(uint8_t* dst, __m128i luma, __m128i cr, __m128i cg, __m128i cb,
+    const PrismYuvCoeffs* coeffs, bool bgra) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi16(255);
+
+    luma = _mm_slli_epi16(_mm_sub_epi16(luma, _mm_set1_epi16(coeffs->y_offset)), 7);
+    luma = _mm_add_epi16(_mm_mulhrs_epi16(luma, _mm_set1_epi16(coeffs->y_scale)), _mm_set1_epi16(16));
+
+    __m128i r = _mm_srai_epi16(_mm_add_epi16(luma, cr), 5);
+    __m128i g = _mm_srai_epi16(_mm_sub_epi16(luma, cg), 5);
+    __m128i b = _mm_srai_epi16(_mm_add_epi16(luma, cb), 5);
+    r = _mm_min_epi16(_mm_max_epi16(r, zero), max);
+    g = _mm_min_epi16(_mm_max_epi16(g, zero), max);
+    b = _mm_min_epi16(_mm_max_epi16(b, zero), max);
+    if (bgra) {
+        __m128i t = r;
+        r = b;
+        b = t;
+    }
+
+    __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+    __m128i ba = _mm_or_si128(b, _mm_set1_epi16((short)0xFF00));
+    _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(rg, ba));
+}
+
+PRISM_TARGET("sse4.1")
+static void yuv_row_sse41(const uint8_t* y, const uint8_t* u, const uint8_t* v, int uv_step,
+    uint8_t* dst, int width, const PrismYuvCoeffs* coeffs, bool bgra) {
+    const __m128i chroma_offset = _mm_set1_epi16(128);
+    const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+    const __m128i r_v = _mm_set1_epi16(coeffs->r_v);
+    const __m128i g_u = _mm_set1_epi16(coeffs->g_u);
+    const __m128i g_v = _mm_set1_epi16(coeffs->g_v);
+    const __m128i b_u = _mm_set1_epi16(coeffs->b_u);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i cu, cv;
+        if (uv_step == 2) {
+            __m128i uv = _mm_loadu_si128((const __m128i*)(u + x));
+            cu = _mm_and_si128(uv, low_bytes);
+            cv = _mm_srli_epi16(uv, 8);
+        } else {
+            cu = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(u + x / 2)));
+            cv = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(v + x / 2)));
+        }
+        cu = _mm_slli_epi16(_mm_sub_epi16(cu, chroma_offset), 7);
+        cv = _mm_slli_epi16(_mm_sub_epi16(cv, chroma_offset), 7);
+
+        __m128i cr = _mm_mulhrs_epi16(cv, r_v);
+        __m128i cg = _mm_add_epi16(_mm_mulhrs_epi16(cu, g_u), _mm_mulhrs_epi16(cv, g_v));
+        __m128i cb = _mm_mulhrs_epi16(cu, b_u);
+
+        __m128i luma = _mm_loadu_si128((const __m128i*)(y + x));
+        store8_sse41(dst + x * 4, _mm_cvtepu8_epi16(luma),
+            _mm_unpacklo_epi16(cr, cr), _mm_unpacklo_epi16(cg, cg), _mm_unpacklo_epi16(cb, cb),
+            coeffs, bgra);
+        store8_sse41(dst + x * 4 + 32, _mm_unpackhi_epi8(luma, _mm_setzero_si128()),
+            _mm_unpackhi_epi16(cr, cr), _mm_unpackhi_epi16(cg, cg), _mm_unpackhi_epi16(cb, cb),
+            coeffs, bgra);
+    }
+
+    if (x < width) {
+        prism_yuv_row_c(y + x, u + (x / 2) * uv_step, v + (x / 2) * uv_step, uv_step,
+            dst + x * 4, width - x, coeffs, bgra);
+    }
+}
+
+/* ============================================================================
+ * AVX2 (32 pixels per iteration)
+ *
+ * 256-bit unpacks work within 128-bit lanes, so chroma replication and the
+ * final pixel interleave are followed by a cross-lane permute.
+ * ========================================================================== */
+
+/* 16 pixels -> 64 bytes */
+PRISM_TARGET("avx2")
+static inline void store16_avx2(uint8_t* dst, __m256i luma, __m256i cr, __m256i cg, __m256i cb,
+    const PrismYuvCoeffs* coeffs, bool bgra) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi16(255);
+
+    luma = _mm256_slli_epi16(_mm256_sub_epi16(luma, _mm256_set1_epi16(coeffs->y_offset)), 7);
+    luma = _mm256_add_epi16(_mm256_mulhrs_epi16(luma, _mm256_set1_epi16(coeffs->y_scale)), _mm256_set1_epi16(16));
+
+    __m256i r = _mm256_srai_epi16(_mm256_add_epi16(luma, cr), 5);
+    __m256i g = _mm256_srai_epi16(_mm256_sub_epi16(luma, cg), 5);
+    __m256i b = _mm256_srai_epi16(_mm256_add_epi16(luma, cb), 5);
+    r = _mm256_min_epi16(_mm256_max_epi16(r, zero), max);
+    g = _mm256_min_epi16(_mm256_max_epi16(g, zero), max);
+    b = _mm256_min_epi16(_mm256_max_epi16(b, zero), max);
+    if (bgra) {
+        __m256i t = r;
+        r = b;
+        b = t;
+    }
+
+    __m256i rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+    __m256i ba = _mm256_or_si256(b, _mm256_set1_epi16((short)0xFF00));
+    __m256i lo = _mm256_unpacklo_epi16(rg, ba);    /* pixels 0-3, 8-11 */
+    __m256i hi = _mm256_unpackhi_epi16(rg, ba);    /* pixels 4-7, 12-15 */
+    _mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i*)(dst + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+PRISM_TARGET("avx2")
+static void yuv_row_avx2(const uint8_t* y, const uint8_t* u, const uint8_t* v, int uv_step,
+    uint8_t* dst, int width, const PrismYuvCoeffs* coeffs, bool bgra) {
+    const __m256i chroma_offset = _mm256_set1_epi16(128);
+    const __m256i low_bytes = _mm256_set1_epi16(0x00FF);
+    const __m256i r_v = _mm256_set1_epi16(coeffs->r_v);
+    const __m256i g_u = _mm256_set1_epi16(coeffs->g_u);
+    const __m256i g_v = _mm256_set1_epi16(coeffs->g_v);
+    const __m256i b_u = _mm256_set1_epi16(coeffs->b_u);
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i cu, cv;
+        if (uv_step == 2) {
+            __m256i uv = _mm256_loadu_si256((const __m256i*)(u + x));
+            cu = _mm256_and_si256(uv, low_bytes);
+            cv = _mm256_srli_epi16(uv, 8);
+        } else {
+            cu = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(u + x / 2)));
+            cv = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(v + x / 2)));
+        }
+        cu = _mm256_slli_epi16(_mm256_sub_epi16(cu, chroma_offset), 7);
+        cv = _mm256_slli_epi16(_mm256_sub_epi16(cv, chroma_offset), 7);
+
+        __m256i cr = _mm256_mulhrs_epi16(cv, r_v);
+        __m256i cg = _mm256_add_epi16(_mm256_mulhrs_epi16(cu, g_u), _mm256_mulhrs_epi16(cv, g_v));
+        __m256i cb = _mm256_mulhrs_epi16(cu, b_u);
+
+        /* Replicate each chroma term across its two pixels, in pixel order */
+        __m256i cr_lo = _mm256_unpacklo_epi16(cr, cr), cr_hi = _mm256_unpackhi_epi16(cr, cr);
+        __m256i cg_lo = _mm256_unpacklo_epi16(cg, cg), cg_hi = _mm256_unpackhi_epi16(cg, cg);
+        __m256i cb_lo = _mm256_unpacklo_epi16(cb, cb), cb_hi = _mm256_unpackhi_epi16(cb, cb);
+
+        store16_avx2(dst + x * 4,
+            _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(y + x))),
+            _mm256_permute2x128_si256(cr_lo, cr_hi, 0x20),
+            _mm256_permute2x128_si256(cg_lo, cg_hi, 0x20),
+            _mm256_permute2x128_si256(cb_lo, cb_hi, 0x20),
+            coeffs, bgra);
+        store16_avx2(dst + x * 4 + 64,
+            _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(y + x + 16))),
+            _mm256_permute2x128_si256(cr_lo, cr_hi, 0x31),
+            _mm256_permute2x128_si256(cg_lo, cg_hi, 0x31),
+            _mm256_permute2x128_si256(cb_lo, cb_hi, 0x31),
+            coeffs, bgra);
+    }
+
+    if (x < width) {
+        prism_yuv_row_c(y + x, u + (x / 2) * uv_step, v + (x / 2) * uv_step, uv_step,
+            dst + x * 4, width - x, coeffs, bgra);
+    }
+}
+
+/* ============================================================================
+ * AVX-512 (64 pixels per iteration, requires AVX-512BW)
+ * ========================================================================== */
+
+/* 32 pixels -> 128 bytes */
+PRISM_TARGET("avx512f,avx512bw")
+static inline void store32_avx512(uint8_t* dst, __m512i luma, __m512i cr, __m512i cg, __m512i cb,
+    const PrismYuvCoeffs* coeffs, bool bgra) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i max = _mm512_set1_epi16(255);
+    const __m512i first = _mm512_set_epi64(11, 10, 3, 2, 9, 8, 1, 0);
+    const __m512i second = _mm512_set_epi64(15, 14, 7, 6, 13, 12, 5, 4);
+
+    luma = _mm512_slli_epi16(_mm512_sub_epi16(luma, _mm512_set1_epi16(coeffs->y_offset)), 7);
+    luma = _mm512_add_epi16(_mm512_mulhrs_epi16(luma, _mm512_set1_epi16(coeffs->y_scale)), _mm512_set1_epi16(16));
+
+    __m512i r = _mm512_srai_epi16(_mm512_add_epi16(luma, cr), 5);
+    __m512i g = _mm512_srai_epi16(_mm512_sub_epi16(luma, cg), 5);
+    __m512i b = _mm512_srai_epi16(_mm512_add_epi16(luma, cb), 5);
+    r = _mm512_min_epi16(_mm512_max_epi16(r, zero), max);
+    g = _mm512_min_epi16(_mm512_max_epi16(g, zero), max);
+    b = _mm512_min_epi16(_mm512_max_epi16(b, zero), max);
+    if (bgra) {
+        __m512i t = r;
+        r = b;
+        b = t;
+    }
+
+    __m512i rg = _mm512_or_si512(r, _mm512_slli_epi16(g, 8));
+    __m512i ba = _mm512_or_si512(b, _mm512_set1_epi16((short)0xFF00));
+    __m512i lo = _mm512_unpacklo_epi16(rg, ba);    /* pixels 0-3, 8-11, 16-19, 24-27 */
+    __m512i hi = _mm512_unpackhi_epi16(rg, ba);    /* pixels 4-7, 12-15, 20-23, 28-31 */
+    _mm512_storeu_si512((void*)dst, _mm512_permutex2var_epi64(lo, first, hi));
+    _mm512_storeu_si512((void*)(dst + 64), _mm512_permutex2var_epi64(lo, second, hi));
+}
+
+PRISM_TARGET("avx512f,avx512bw")
+static void yuv_row_avx512(const uint8_t* y, const uint8_t* u, const uint8_t* v, int uv_step,
+    uint8_t* dst, int width, const PrismYuvCoeffs* coeffs, bool bgra) {
+    const __m512i chroma_offset = _mm512_set1_epi16(128);
+    const __m512i low_bytes = _mm512_set1_epi16(0x00FF);
+    const __m512i r_v = _mm512_set1_epi16(coeffs->r_v);
+    const __m512i g_u = _mm512_set1_epi16(coeffs->g_u);
+    const __m512i g_v = _mm512_set1_epi16(coeffs->g_v);
+    const __m512i b_u = _mm512_set1_epi16(coeffs->b_u);
+    const __m512i first = _mm512_set_epi64(11, 10, 3, 2, 9, 8, 1, 0);
+    const __m512i second = _mm512_set_epi64(15, 14, 7, 6, 13, 12, 5, 4);
+
+    int x = 0;
+    for (; x + 64 <= width; x += 64) {
+        __m512i cu, cv;
+        if (uv_step == 2) {
+            __m512i uv = _mm512_loadu_si512((const void*)(u + x));
+            cu = _mm512_and_si512(uv, low_bytes);
+            cv = _mm512_srli_epi16(uv, 8);
+        } else {
+            cu = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(u + x / 2)));
+            cv = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(v + x / 2)));
+        }
+        cu = _mm512_slli_epi16(_mm512_sub_epi16(cu, chroma_offset), 7);
+        cv = _mm512_slli_epi16(_mm512_sub_epi16(cv, chroma_offset), 7);
+
+        __m512i cr = _mm512_mulhrs_epi16(cv, r_v);
+        __m512i cg = _mm512_add_epi16(_mm512_mulhrs_epi16(cu, g_u), _mm512_mulhrs_epi16(cv, g_v));
+        __m512i cb = _mm512_mulhrs_epi16(cu, b_u);
+
+        /* Replicate each chroma term across its two pixels, in pixel order */
+        __m512i cr_lo = _mm512_unpacklo_epi16(cr, cr), cr_hi = _mm512_unpackhi_epi16(cr, cr);
+        __m512i cg_lo = _mm512_unpacklo_epi16(cg, cg), cg_hi = _mm512_unpackhi_epi16(cg, cg);
+        __m512i cb_lo = _mm512_unpacklo_epi16(cb, cb), cb_hi = _mm512_unpackhi_epi16(cb, cb);
+
+        store32_avx512(dst + x * 4,
+            _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(y + x))),
+            _mm512_permutex2var_epi64(cr_lo, first, cr_hi),
+            _mm512_permutex2var_epi64(cg_lo, first, cg_hi),
+            _mm512_permutex2var_epi64(cb_lo, first, cb_hi),
+            coeffs, bgra);
+        store32_avx512(dst + x * 4 + 128,
+            _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(y + x + 32))),
+            _mm512_permutex2var_epi64(cr_lo, second, cr_hi),
+            _mm512_permutex2var_epi64(cg_lo, second, cg_hi),
+            _mm512_permutex2var_epi64(cb_lo, second, cb_hi),
+            coeffs, bgra);
+    }
+
+    if (x < width) {
+        prism_yuv_row_c(y + x, u + (x / 2) * uv_step, v + (x / 2) * uv_step, uv_step,
+            dst + x * 4, width - x, coeffs, bgra);
+    }
+}
+
+#endif /* PRISM_YUV_X86 */
+
+/* ============================================================================
+ * NEON (16 pixels per iteration, AArch64)
+ * ========================================================================== */
+
+#ifdef PRISM_YUV_NEON
+
+/* vqrdmulh computes (2ab + 2^15) >> 16, the same rounding as mulhrs */
+static void yuv_row_neon(const uint8_t* y, const uint8_t* u, const uint8_t* v, int uv_step,
+    uint8_t* dst, int width, const PrismYuvCoeffs* coeffs, bool bgra) {
+    const int16x8_t chroma_offset = vdupq_n_s16(128);
+    const int16x8_t y_offset = vdupq_n_s16(coeffs->y_offset);
+    const int16x8_t y_scale = vdupq_n_s16(coeffs->y_scale);
+    const int16x8_t rounding = vdupq_n_s16(16);
+    const int16x8_t r_v = vdupq_n_s16(coeffs->r_v);
+    const int16x8_t g_u = vdupq_n_s16(coeffs->g_u);
+    const int16x8_t g_v = vdupq_n_s16(coeffs->g_v);
+    const int16x8_t b_u = vdupq_n_s16(coeffs->b_u);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x8_t u8, v8;
+        if (uv_step == 2) {
+            uint8x8x2_t uv = vld2_u8(u + x);
+            u8 = uv.val[0];
+            v8 = uv.val[1];
+        } else {
+            u8 = vld1_u8(u + x / 2);
+            v8 = vld1_u8(v + x / 2);
+        }
+        int16x8_t cu = vshlq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u8)), chroma_offset), 7);
+        int16x8_t cv = vshlq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v8)), chroma_offset), 7);
+
+        int16x8_t cr = vqrdmulhq_s16(cv, r_v);
+        int16x8_t cg = vaddq_s16(vqrdmulhq_s16(cu, g_u), vqrdmulhq_s16(cv, g_v));
+        int16x8_t cb = vqrdmulhq_s16(cu, b_u);
+
+        uint8x16_t luma8 = vld1q_u8(y + x);
+        int16x8_t luma[2] = {
+            vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(luma8))),
+            vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(luma8)))
+        };
+        int16x8_t crs[2] = { vzip1q_s16(cr, cr), vzip2q_s16(cr, cr) };
+        int16x8_t cgs[2] = { vzip1q_s16(cg, cg), vzip2q_s16(cg, cg) };
+        int16x8_t cbs[2] = { vzip1q_s16(cb, cb), vzip2q_s16(cb, cb) };
+
+        uint8x8_t r[2], g[2], b[2];
+        for (int half = 0; half < 2; half++) {
+            int16x8_t l = vshlq_n_s16(vsubq_s16(luma[half], y_offset), 7);
+            l = vaddq_s16(vqrdmulhq_s16(l, y_scale), rounding);
+            r[half] = vqmovun_s16(vshrq_n_s16(vaddq_s16(l, crs[half]), 5));
+            g[half] = vqmovun_s16(vshrq_n_s16(vsubq_s16(l, cgs[half]), 5));
+            b[half] = vqmovun_s16(vshrq_n_s16(vaddq_s16(l, cbs[half]), 5));
+        }
+
+        uint8x16x4_t pixels;
+        pixels.val[bgra ? 2 : 0] = vcombine_u8(r[0], r[1]);
+        pixels.val[1] = vcombine_u8(g[0], g[1]);
+        pixels.val[bgra ? 0 : 2] = vcombine_u8(b[0], b[1]);
+        pixels.val[3] = vdupq_n_u8(255);
+        vst4q_u8(dst + x * 4, pixels);
+    }
+
+    if (x < width) {
+        prism_yuv_row_c(y + x, u + (x / 2) * uv_step, v + (x / 2) * uv_step, uv_step,
+            dst + x * 4, width - x, coeffs, bgra);
+    }
+}
+
+#endif /* PRISM_YUV_NEON */
+
+/* ============================================================================
+ * Dispatch
+ * ========================================================================== */
+
+bool prism_yuv_kernel_init(PrismYuvKernel* kernel, enum AVPixelFormat src, enum AVPixelFormat dst, int cpu_flags) {
+    if (src != AV_PIX_FMT_YUV420P && src != AV_PIX_FMT_YUVJ420P && src != AV_PIX_FMT_NV12) {
+        return false;
+    }
+    if (dst != AV_PIX_FMT_RGBA && dst != AV_PIX_FMT_BGRA) {
+        return false;
+    }
+
+    kernel->row = NULL;
+    kernel->name = NULL;
+#ifdef PRISM_YUV_X86
+    if (cpu_flags & AV_CPU_FLAG_AVX512) {
+        kernel->row = yuv_row_avx512;
+        kernel->name = "avx512";
+    } else if (cpu_flags & AV_CPU_FLAG_AVX2) {
+        kernel->row = yuv_row_avx2;
+        kernel->name = "avx2";
+    } else if (cpu_flags & AV_CPU_FLAG_SSE4) {
+        kernel->row = yuv_row_sse41;
+        kernel->name = "sse4.1";
+    }
+#elif defined(PRISM_YUV_NEON)
+    if (cpu_flags & AV_CPU_FLAG_NEON) {
+        kernel->row = yuv_row_neon;
+        kernel->name = "neon";
+    }
+#endif
+    if (!kernel->row) {
+        return false;
+    }
+
+    /* swscale's defaults when no colorspace details are set */
+    init_coeffs(&kernel->coeffs, 0.299, 0.114, src == AV_PIX_FMT_YUVJ420P);
+    kernel->src_format = src;
+    kernel->nv12 = (src == AV_PIX_FMT_NV12);
+    kernel->bgra = (dst == AV_PIX_FMT_BGRA);
+    return true;
+}
+
+void prism_yuv_kernel_convert(const PrismYuvKernel* kernel, const AVFrame* src, AVFrame* dst,
+    int row_start, int row_end) {
+    int uv_step = kernel->nv12 ? 2 : 1;
+
+    for (int row = row_start; row < row_end; row++) {
+        const uint8_t* y = src->data[0] + (ptrdiff_t)row * src->linesize[0];
+        const uint8_t* u = src->data[1] + (ptrdiff_t)(row >> 1) * src->linesize[1];
+        const uint8_t* v = kernel->nv12 ? u + 1 : src->data[2] + (ptrdiff_t)(row >> 1) * src->linesize[2];
+        uint8_t* out = dst->data[0] + (ptrdiff_t)row * dst->linesize[0];
+
+        kernel->row(y, u, v, uv_step, out, src->width, &kernel->coeffs, kernel->bgra);
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * Prism FFmpeg Native Plugin - YUV to RGB conversion kernels
+ *
+ * Specialized 8-bit 4:2:0 to RGBA/BGRA converters with runtime CPU dispatch.
+ * Used instead of swscale for the most common source/destination pairs.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#ifndef PRISM_CONVERT_H
+#define PRISM_CONVERT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+
+/* Fixed-point conversion coefficients.
+ * Luma and centered chroma are scaled by 2^7 and multiplied with Q13
+ * coefficients using a rounding high multiply, giving Q5 results. */
+typedef struct PrismYuvCoeffs {
+    int16_t y_offset;   /* 16 for limited range, 0 for full range */
+    int16_t y_scale;
+    int16_t r_v;
+    int16_t g_u;
+    int16_t g_v;
+    int16_t b_u;
+} PrismYuvCoeffs;
+
+/* Converts one row. u and v point at the row's chroma; uv_step is 1 for
+ * separate U/V planes and 2 for interleaved NV12 chroma (v = u + 1). */
+typedef void (*PrismYuvRowFunc)(const uint8_t* y, const uint8_t* u, const uint8_t* v, int uv_step,
+    uint8_t* dst, int width, const PrismYuvCoeffs* coeffs, bool bgra);
+
+typedef struct PrismYuvKernel {
+    PrismYuvRowFunc row;
+    PrismYuvCoeffs coeffs;
+    enum AVPixelFormat src_format;
+    bool nv12;
+    bool bgra;
+    const char* name;   /* Instruction set the row function uses */
+} PrismYuvKernel;
+
+/* Set up a kernel for src -> dst using the best instruction set in cpu_flags
+ * (from av_get_cpu_flags). Coefficients match swscale's defaults: BT.601,
+ * limited range except YUVJ420P. Returns false when the pair is unsupported
+ * or no SIMD implementation is available, in which case swscale is used. */
+bool prism_yuv_kernel_init(PrismYuvKernel* kernel, enum AVPixelFormat src, enum AVPixelFormat dst, int cpu_flags);
+
+/* Convert rows [row_start, row_end) of src into dst. Both frames must have
+ * the kernel's geometry; row_start must be even. */
+void prism_yuv_kernel_convert(const PrismYuvKernel* kernel, const AVFrame* src, AVFrame* dst,
+    int row_start, int row_end);
+
+/* Portable reference row converter. SIMD kernels produce identical output. */
+void prism_yuv_row_c(const uint8_t* y, const uint8_t* u, const uint8_t* v, int uv_step,
+    uint8_t* dst, int width, const PrismYuvCoeffs* coeffs, bool bgra);
+
+#endif /* PRISM_CONVERT_H */
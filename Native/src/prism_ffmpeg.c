@@ -8,10 +8,18 @@
 #define PRISM_FFMPEG_EXPORTS
 
 #include "prism_ffmpeg.h"
+#include "prism_convert.h"
+#include "prism_index.h"
+#include "prism_io.h"
+#include "prism_cache.h"
+#include "prism_pool.h"
 
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libavutil/buffer.h>
+#include <libavutil/cpu.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/mem.h>
 #include <libavutil/opt.h>
 #include <libavutil/time.h>
 #include <libswscale/swscale.h>
@@ -25,6 +33,7 @@
 #include <windows.h>
 #else
 #include <pthread.h>
+#include <time.h>
 #include <unistd.h>
 #endif
 
@@ -38,17 +47,129 @@
  * Internal Structures
  * ========================================================================== */
 
-/* Video frame queue entry */
-#define VIDEO_QUEUE_SIZE 8
+/* Atomic counter shared between exactly one writer and one reader thread */
+#ifdef _WIN32
+typedef volatile LONG prism_atomic_t;
+#else
+typedef volatile unsigned int prism_atomic_t;
+#endif
+
+/* Wakeup event: a waiter samples the sequence number before checking its
+ * condition and sleeps until a signal moves it on, so no wakeup is lost
+ * between the check and the wait */
 typedef struct {
-    uint8_t* data;
-    int width;
-    int height;
-    int stride;
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+    prism_atomic_t seq;
+} PrismEvent;
+
+/* Thread entry point signature */
+#ifdef _WIN32
+typedef HANDLE prism_thread_t;
+typedef DWORD prism_thread_ret_t;
+#define PRISM_THREAD_CALL WINAPI
+#else
+typedef pthread_t prism_thread_t;
+typedef void* prism_thread_ret_t;
+#define PRISM_THREAD_CALL
+#endif
+
+/* Video frame queue entry. The frame is refcounted: its planes live either in
+ * a buffer from the player's frame pool (converted output) or in the decoder's
+ * own buffers (native-format passthrough). Ownership moves decoder -> queue -> display. */
+#define VIDEO_QUEUE_SIZE 8          /* Must be a power of two */
+typedef struct {
+    AVFrame* frame;
     double pts;
-    bool valid;
+    bool resync;        /* First frame after a loop restart or seek: re-sync the clock on display */
+    unsigned int serial; /* Command serial the frame was decoded under */
 } VideoFrameEntry;
 
+/* Demuxed packet queue entry. FLUSH (stream restarted by looping) and EOF
+ * markers travel in-band so each decoder sees them in order with the packets
+ * around them; both make the decoder drain its buffered frames. SEEK markers
+ * start a new serial: the decoder drops its buffered frames and adopts it.
+ * Entries whose serial is older than the player's are skipped unread. */
+typedef enum {
+    PACKET_DATA,
+    PACKET_FLUSH,
+    PACKET_EOF,
+    PACKET_SEEK
+} PacketKind;
+
+typedef struct {
+    AVPacket* packet;
+    PacketKind kind;
+    unsigned int serial;
+    double seek_target;     /* PACKET_SEEK: discard output before this, < 0 for keyframe seeks */
+} PacketQueueEntry;
+
+/* Bounded single-producer (demux thread) / single-consumer (decode thread)
+ * packet ring. Capacities must be powers of two. */
+#define VIDEO_PACKET_QUEUE_SIZE 64
+#define AUDIO_PACKET_QUEUE_SIZE 128
+typedef struct {
+    PacketQueueEntry* entries;
+    unsigned int capacity;
+    prism_atomic_t write;
+    prism_atomic_t read;
+} PacketQueue;
+
+/* Worker converting one band of each frame the SIMD kernel converts */
+typedef struct {
+    PrismPlayer* player;
+    prism_thread_t thread;
+    int band;
+} ConvertWorker;
+
+/* Background keyframe index progress */
+typedef enum {
+    INDEX_NONE,
+    INDEX_BUILDING,     /* Index thread owns keyframe_index */
+    INDEX_READY,        /* Built, waiting for the demux thread to merge it */
+    INDEX_APPLIED
+} IndexState;
+
+/* Control commands posted by the host and applied by the demux thread, so
+ * Seek and Stop return immediately and the pipeline keeps running */
+#define COMMAND_QUEUE_SIZE 8
+typedef enum {
+    COMMAND_SEEK,
+    COMMAND_STOP
+} CommandType;
+
+typedef struct {
+    CommandType type;
+    double position;
+    PrismSeekMode mode;
+    unsigned int serial;
+} PrismCommand;
+
+/* Adaptive bitrate: a variant is chosen if its bitrate fits in ABR_SAFETY of
+ * the bandwidth estimate; stepping up also needs ABR_UP_SEGMENTS segments
+ * since the last switch and decode time under ABR_UP_HEADROOM of the frame
+ * duration. Above ABR_DOWN_HEADROOM the controller steps down. */
+#define ABR_MAX_VARIANTS 16
+#define ABR_SAFETY 0.8
+#define ABR_UP_SEGMENTS 2
+#define ABR_UP_HEADROOM 0.6
+#define ABR_DOWN_HEADROOM 0.9
+#define ABR_MIN_SAMPLE_BYTES (32 * 1024)
+
+/* One HLS/DASH variant: its streams in the format context */
+typedef struct {
+    int video_stream;
+    int audio_stream;               /* -1 = keep the current audio stream */
+    int64_t bitrate;
+    int width;
+    int height;
+} AbrVariant;
+
 struct PrismPlayer {
     /* FFmpeg contexts */
     AVFormatContext* format_ctx;
@@ -61,20 +182,93 @@ struct PrismPlayer {
     int video_stream_idx;
     int audio_stream_idx;
 
-    /* Frames and packets (used by decoder thread) */
+    /* Frames, packets and scratch reused for every decode, so steady-state
+     * playback does not allocate (frame: video decode thread, audio_frame and
+     * audio_scratch: audio decode thread, packet: demux thread) */
     AVFrame* frame;
-    AVFrame* rgb_frame;
+    AVFrame* audio_frame;
     AVPacket* packet;
-    uint8_t* video_buffer;          /* Temp buffer for frame conversion in decoder thread */
-    int video_buffer_size;
-
-    /* Video frame queue (thread-safe) */
+    int audio_out_rate;                 /* Resampler output rate, stereo */
+    float* audio_scratch;
+    unsigned int audio_scratch_size;    /* In bytes, grows only */
+
+    /* Custom input I/O (NULL when FFmpeg's protocols read directly), set and
+     * cleared under state_lock: network input read ahead by its own I/O
+     * thread, or a memory-mapped local file */
+    PrismReadAhead* read_ahead;
+    size_t read_ahead_size;         /* Requested ring size, 0 = disabled */
+    PrismMappedFile* mapped_file;
+    AVIOContext* cached_input;      /* Media cache without read-ahead */
+    PrismFileBackend file_backend;  /* Requested, applies from the next Open */
+
+    /* Adaptive bitrate. Variants are fixed at Open; the rest is owned by the
+     * demux thread, and what the API reports is copied under state_lock. */
+    bool abr_enabled;               /* Requested, applies from the next Open */
+    bool abr_metering;              /* Segment reads go through abr_meter */
+    AbrVariant abr_variants[ABR_MAX_VARIANTS];
+    int abr_variant_count;          /* 0 = not adaptive */
+    int abr_current;
+    PrismThroughputMeter abr_meter;
+    int64_t abr_seen_bytes;
+    int64_t abr_seen_us;
+    unsigned int abr_seen_segments;
+    int abr_segments_since_switch;
+    double abr_fast;                /* Bandwidth averages (bits per second) */
+    double abr_slow;
+    double abr_bandwidth;           /* min(fast, slow), under state_lock */
+    int abr_switches;               /* Under state_lock */
+    PrismAbrReason abr_last_reason; /* Under state_lock */
+    double abr_last_switch_time;    /* Under state_lock */
+    bool abr_switch_pending;        /* Drop the new variant's video up to its first keyframe */
+    AVRational abr_video_time_base; /* Packets of every variant are rescaled to the first one's */
+    AVRational abr_audio_time_base;
+    int abr_output_width;           /* Largest variant, the output size while adaptive */
+    int abr_output_height;
+    double decode_ms_avg;           /* Video decode thread, under state_lock */
+
+    /* Source geometry sws_ctx and yuv_kernel convert from; a frame that
+     * differs rebuilds them (0 width forces a rebuild) */
+    int sws_src_width;
+    int sws_src_height;
+    enum AVPixelFormat sws_src_format;
+
+    /* Source audio format swr_ctx resamples from */
+    int swr_in_rate;
+    enum AVSampleFormat swr_in_format;
+    AVChannelLayout swr_in_layout;
+
+    /* FFmpeg's own nested I/O callbacks, wrapped to cache and meter segments */
+    int (*default_io_open)(AVFormatContext* s, AVIOContext** pb, const char* url, int flags, AVDictionary** options);
+    int (*default_io_close2)(AVFormatContext* s, AVIOContext* pb);
+
+    /* Demux read timing (demux thread, under state_lock) */
+    int64_t demux_read_us;
+    int64_t demux_bytes;
+
+    /* Demuxed packets waiting for each decode thread */
+    PacketQueue video_packets;
+    PacketQueue audio_packets;
+
+    /* Converted frame buffers. sws_scale writes straight into a pooled buffer
+     * which is then handed through the queue to the display without copying. */
+    AVBufferPool* frame_pool;
+    int frame_buffer_size;
+    enum AVPixelFormat video_dst_fmt;
+    int output_max_width;           /* Requested output bounds, 0 = source size (state_lock) */
+    int output_max_height;
+    bool lowres_enabled;            /* Requested, applies from the next Open */
+
+    /* Video frame queue: lock-free single-producer (video decode thread) /
+     * single-consumer (update thread) ring. The indices are free-running
+     * counters; only the producer advances write, only the consumer advances read. */
     VideoFrameEntry video_queue[VIDEO_QUEUE_SIZE];
-    int video_queue_write;
-    int video_queue_read;
-    int video_queue_count;
+    prism_atomic_t video_queue_write;
+    prism_atomic_t video_queue_read;
 
-    /* Current display frame (for main thread) */
+    /* Current display frame (owned by the update thread). display_frame pins the
+     * frame's buffers until the next frame is shown or the media is closed;
+     * display_buffer/stride describe its first plane. */
+    AVFrame* display_frame;
     uint8_t* display_buffer;
     int display_width;
     int display_height;
@@ -82,12 +276,16 @@ struct PrismPlayer {
     double display_pts;
     bool display_ready;
 
-    /* Audio ring buffer for proper queuing */
+    /* Audio ring buffer: lock-free single-producer (audio decode thread) /
+     * single-consumer (host audio thread). Positions are free-running sample
+     * counters; only the producer advances write, only the consumer advances read. */
     float* audio_buffer;
-    int audio_buffer_size;      /* Total buffer size in samples */
-    int audio_write_pos;        /* Write position in ring buffer */
-    int audio_read_pos;         /* Read position in ring buffer */
-    int audio_available;        /* Available samples to read */
+    unsigned int audio_buffer_size; /* Capacity in samples, power of two */
+    unsigned int audio_fill_target; /* Decoding pauses above this many buffered samples */
+    prism_atomic_t audio_write_pos;
+    prism_atomic_t audio_read_pos;
+    prism_atomic_t audio_flush;     /* Set when the consumer should skip to audio_flush_pos */
+    prism_atomic_t audio_flush_pos;
 
     /* State */
     PrismState state;
@@ -106,20 +304,71 @@ struct PrismPlayer {
     double frame_duration;          /* Expected frame duration in seconds */
     bool is_live;
     bool loop;
+
+    /* Low-latency live playback */
+    bool low_latency;               /* Requested, applies from the next Open */
+    bool low_latency_active;        /* Open media is live and low_latency was requested */
+    double target_latency;          /* Seconds behind the newest demuxed video packet */
+    double live_edge_pts;           /* Newest demuxed video packet time (under state_lock) */
+    double live_latency;            /* Update thread: latency of the displayed frame */
+    double live_rate;               /* Update thread: playback rate correcting latency drift */
+    prism_atomic_t live_rate_permyriad; /* live_rate for the audio decode thread, 10000 = 1.0x */
+    unsigned int live_rate_applied; /* Audio decode thread: rate the resampler compensates for */
+    int64_t live_frames_dropped;
     float speed;
     float volume;
 
     /* Output settings */
     PrismPixelFormat output_format;
     bool use_hw_accel;
+    PrismThreadMode decode_thread_mode;
+    PrismOpenProfile open_profile;
+    int decode_thread_count;        /* Requested decoder threads, 0 = share of the core budget */
+    int convert_thread_count;       /* Requested color conversion threads, 0 = share of the core budget */
+    int convert_threads;            /* Slice threads the open conversion context uses */
+    PrismYuvKernel yuv_kernel;      /* SIMD YUV -> RGBA/BGRA path, used instead of sws_ctx */
+    bool use_yuv_kernel;
+
+    /* Kernel conversion bands: the video decode thread converts the first,
+     * one worker each of the others. Workers run from the first kernel
+     * setup until Close. */
+    ConvertWorker* convert_workers;
+    int convert_worker_count;
+    int convert_bands;              /* Workers + 1 */
+    PrismEvent convert_wake;        /* Frame posted to the workers, or stop */
+    PrismEvent convert_done;        /* Last worker band of the posted frame finished */
+    prism_atomic_t convert_posted;  /* Frames posted so far */
+    prism_atomic_t convert_pending; /* Worker bands of the posted frame not finished */
+    prism_atomic_t convert_stop;
+    const AVFrame* convert_src;
+    AVFrame* convert_dst;
+
+    /* Color conversion timing (written by the video decode thread under state_lock) */
+    int64_t frames_converted;
+    double convert_ms_last;
+    double convert_ms_total;
+    double convert_ms_max;
+
+    /* Last Open timing */
+    double open_ms;
+    double probe_ms;                /* avformat_find_stream_info, 0 when skipped */
+    bool open_warm;                 /* Stream info came from the headers or the cache */
     int output_sample_rate;  /* Audio output sample rate (default 48000, should match Unity) */
 
     /* Frame info */
     int video_width;
     int video_height;
-    int video_stride;
     bool first_frame_decoded;       /* Track if we've decoded the first frame */
     bool first_frame_displayed;     /* Track if we've displayed the first frame (for clock sync) */
+
+    /* Prepare: demux and decode ahead while not playing (under state_lock) */
+    double preroll_seconds;         /* Watermark: media to queue before preroll is done */
+    bool prerolling;
+    bool preroll_done;
+    bool preroll_started;           /* preroll_start holds the first prerolled packet's time */
+    double preroll_start;
+    bool poster_pending;            /* Update thread: show the first prerolled frame while not playing */
+    bool poster_shown;              /* Update thread: the displayed frame is the poster, playback resumes from it */
     int64_t last_frame_display_time; /* When we last displayed a frame (for pacing) */
 
     /* Callbacks */
@@ -127,19 +376,54 @@ struct PrismPlayer {
     void* video_callback_user_data;
     PrismAudioSamplesCallback audio_callback;
     void* audio_callback_user_data;
-
-    /* Decoder thread */
-#ifdef _WIN32
-    HANDLE decoder_thread;
-    HANDLE stop_event;
-    CRITICAL_SECTION queue_lock;
-#else
-    pthread_t decoder_thread;
-    bool stop_requested;
-    pthread_mutex_t queue_lock;
-    pthread_cond_t queue_cond;
-#endif
+    PrismVideoSizeCallback video_size_callback;
+    void* video_size_callback_user_data;
+
+    /* Pipeline threads: demux -> packet queues -> video / audio decode */
+    prism_thread_t demux_thread;
+    prism_thread_t video_thread;
+    prism_thread_t audio_thread;
+    bool video_thread_started;
+    bool audio_thread_started;
+    prism_atomic_t stop_requested;
+    PrismEvent demux_wake;          /* State changes, packet queue space freed */
+    PrismEvent video_wake;          /* Video packets queued, frame ring slot freed */
+    PrismEvent audio_wake;          /* Audio packets queued, state changes */
     bool decoder_running;
+    bool video_eof;                 /* Video decoder consumed the EOF marker */
+    bool video_resync_pending;      /* Video decode thread: tag the next frame for clock re-sync */
+
+    /* Command queue (guarded by state_lock). Posting a command bumps serial;
+     * packets, frames and markers carry the serial they were produced under,
+     * so everything from before the newest command is discarded on sight. */
+    PrismCommand commands[COMMAND_QUEUE_SIZE];
+    int command_count;
+    prism_atomic_t serial;          /* Newest posted command */
+    prism_atomic_t completed_serial; /* Newest command the demux thread has applied */
+    unsigned int demux_serial;      /* Owned by the demux thread */
+    unsigned int video_serial;      /* Owned by the video decode thread */
+    unsigned int audio_serial;      /* Owned by the audio decode thread */
+    double demux_seek_target;       /* Owned by the demux thread, carried by SEEK markers */
+
+    /* Exact seek: decoders discard output before their seek target */
+    double video_seek_target;
+    double audio_seek_target;
+    bool video_seek_pending;        /* Owned by the video decode thread while running */
+    bool audio_seek_pending;        /* Owned by the audio decode thread while running */
+    bool audio_eof;                 /* Audio decoder consumed the EOF marker */
+    bool counted;                   /* Open, counted in g_player_count */
+
+    /* Keyframe index for containers without a usable one. Built by a low
+     * priority thread, merged into the demuxer's index by the demux thread. */
+    bool keyframe_index_enabled;
+    PrismKeyframeIndex keyframe_index;
+    char* index_url;
+    char index_cache_path[1024];    /* Empty when the index is not cached */
+    prism_thread_t index_thread;
+    bool index_thread_started;
+    prism_atomic_t index_state;     /* IndexState */
+    prism_atomic_t index_cancel;
+    int index_keyframes;            /* Entries merged into the demuxer (under state_lock) */
 
     /* Thread safety for state */
 #ifdef _WIN32
@@ -152,6 +436,42 @@ struct PrismPlayer {
 /* Global state */
 static PrismLogCallback g_log_callback = NULL;
 static bool g_initialized = false;
+static int g_core_budget = 0;               /* Threads shared by all players, 0 = CPU count */
+static char g_index_cache_dir[1024] = "";   /* Keyframe index cache, empty = no caching */
+
+/* Stream info cache for the fast open profile, shared by all players */
+#define STREAM_INFO_CACHE_SIZE 16
+
+/* Low-latency live playback: drift from the target latency is corrected by
+ * playing at up to +/-5%; frames are only dropped once they fall more than
+ * LIVE_DROP_MARGIN seconds behind the target */
+#define LIVE_RATE_MIN 0.95
+#define LIVE_RATE_MAX 1.05
+#define LIVE_RATE_GAIN 0.1          /* Rate change per second of latency error */
+#define LIVE_RATE_DEADBAND 0.05     /* Latency error (seconds) left uncorrected */
+#define LIVE_RATE_SMOOTHING 0.05    /* Per-frame step towards the new rate */
+#define LIVE_DROP_MARGIN 1.0
+#define LIVE_DEFAULT_LATENCY 1.0
+
+typedef struct StreamInfoEntry {
+    char* url;
+    unsigned int nb_streams;
+    AVCodecParameters** params;
+    AVRational* frame_rates;
+    int64_t duration;
+    int64_t last_used;
+} StreamInfoEntry;
+
+static StreamInfoEntry g_stream_info_cache[STREAM_INFO_CACHE_SIZE];
+#ifdef _WIN32
+static SRWLOCK g_stream_info_lock = SRWLOCK_INIT;
+#else
+static pthread_mutex_t g_stream_info_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+static prism_atomic_t g_player_count = 0;   /* Open players sharing the budget */
+
+/* Part of each player's share that goes to color conversion by default */
+#define CONVERT_SHARE_DIVISOR 4
 
 /* ============================================================================
  * Utility Functions
@@ -194,319 +514,2013 @@ static void unlock_state(PrismPlayer* player) {
 #endif
 }
 
-static void lock_queue(PrismPlayer* player) {
+static unsigned int load_acquire(prism_atomic_t* value) {
 #ifdef _WIN32
-    EnterCriticalSection(&player->queue_lock);
+    return (unsigned int)InterlockedCompareExchange(value, 0, 0);
 #else
-    pthread_mutex_lock(&player->queue_lock);
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
 #endif
 }
 
-static void unlock_queue(PrismPlayer* player) {
+static void store_release(prism_atomic_t* value, unsigned int new_value) {
 #ifdef _WIN32
-    LeaveCriticalSection(&player->queue_lock);
+    InterlockedExchange(value, (LONG)new_value);
 #else
-    pthread_mutex_unlock(&player->queue_lock);
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
 #endif
 }
 
-/* Forward declaration */
-static void stop_decoder_thread(PrismPlayer* player);
+/* Atomically add delta, returns the new value */
+static unsigned int atomic_add(prism_atomic_t* value, int delta) {
+#ifdef _WIN32
+    return (unsigned int)InterlockedExchangeAdd(value, delta) + delta;
+#else
+    return __atomic_add_fetch(value, delta, __ATOMIC_ACQ_REL);
+#endif
+}
 
-/* Decoder thread function */
+/* Atomically replace the value, returns the old value */
+static unsigned int atomic_exchange(prism_atomic_t* value, unsigned int new_value) {
 #ifdef _WIN32
-static DWORD WINAPI decoder_thread_func(LPVOID arg) {
+    return (unsigned int)InterlockedExchange(value, (LONG)new_value);
 #else
-static void* decoder_thread_func(void* arg) {
+    return __atomic_exchange_n(value, new_value, __ATOMIC_ACQ_REL);
 #endif
-    PrismPlayer* player = (PrismPlayer*)arg;
-    AVPacket* packet = av_packet_alloc();
-    AVFrame* frame = av_frame_alloc();
-    AVFrame* rgb_frame = av_frame_alloc();
+}
 
-    prism_log(1, "Decoder thread started");
+/* ============================================================================
+ * Wakeup Events
+ * ========================================================================== */
 
-    while (1) {
-        /* Check if we should stop */
+static void event_init(PrismEvent* event) {
 #ifdef _WIN32
-        if (WaitForSingleObject(player->stop_event, 0) == WAIT_OBJECT_0) {
-            break;
-        }
+    InitializeCriticalSection(&event->lock);
+    InitializeConditionVariable(&event->cond);
 #else
-        lock_state(player);
-        bool should_stop = player->stop_requested;
-        unlock_state(player);
-        if (should_stop) {
-            break;
-        }
+    pthread_mutex_init(&event->lock, NULL);
+    pthread_cond_init(&event->cond, NULL);
 #endif
+    event->seq = 0;
+}
 
-        /* Check player state */
-        lock_state(player);
-        PrismState current_state = player->state;
-        unlock_state(player);
-
-        if (current_state != PRISM_STATE_PLAYING) {
-            /* Sleep a bit when not playing */
+static void event_destroy(PrismEvent* event) {
 #ifdef _WIN32
-            Sleep(10);
+    DeleteCriticalSection(&event->lock);
 #else
-            usleep(10000);
+    pthread_mutex_destroy(&event->lock);
+    pthread_cond_destroy(&event->cond);
 #endif
-            continue;
-        }
+}
 
-        /* Check if we should throttle decoding */
-        lock_queue(player);
-        bool is_live_stream = player->is_live;
-        /* For live streams, keep queue small (2 frames) to minimize latency */
-        int queue_threshold = is_live_stream ? 2 : (VIDEO_QUEUE_SIZE - 1);
-        bool queue_full = (player->video_queue_count >= queue_threshold);
-        /* For live, also keep less audio buffered (250ms vs 1.5s) */
-        int audio_threshold = is_live_stream ?
-            (player->audio_buffer_size / 8) :   /* ~250ms for live */
-            (player->audio_buffer_size * 3 / 4); /* ~1.5s for VOD */
-        bool audio_full = (player->audio_stream_idx < 0) ||
-                          (player->audio_available > audio_threshold);
-        unlock_queue(player);
-
-        if (queue_full && audio_full) {
-            /* Buffers are full enough, wait a bit */
+/* Sample before checking the condition the event guards */
+static unsigned int event_seq(PrismEvent* event) {
+    return load_acquire(&event->seq);
+}
+
+static void event_signal(PrismEvent* event) {
 #ifdef _WIN32
-            Sleep(5);
+    EnterCriticalSection(&event->lock);
+    store_release(&event->seq, event->seq + 1);
+    LeaveCriticalSection(&event->lock);
+    WakeAllConditionVariable(&event->cond);
 #else
-            usleep(5000);
+    pthread_mutex_lock(&event->lock);
+    store_release(&event->seq, event->seq + 1);
+    pthread_mutex_unlock(&event->lock);
+    pthread_cond_broadcast(&event->cond);
 #endif
-            continue;
+}
+
+/* Sleep until the event is signalled after seen was sampled, or until
+ * timeout_ms passes (negative waits indefinitely) */
+static void event_wait(PrismEvent* event, unsigned int seen, int timeout_ms) {
+#ifdef _WIN32
+    EnterCriticalSection(&event->lock);
+    while (event->seq == seen) {
+        if (!SleepConditionVariableCS(&event->cond, &event->lock,
+                timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms)) {
+            break;
+        }
+    }
+    LeaveCriticalSection(&event->lock);
+#else
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
         }
+    }
 
-        /* Read a packet */
-        int ret = av_read_frame(player->format_ctx, packet);
+    pthread_mutex_lock(&event->lock);
+    while (event->seq == seen) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&event->cond, &event->lock);
+        } else if (pthread_cond_timedwait(&event->cond, &event->lock, &deadline) != 0) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&event->lock);
+#endif
+}
 
-        if (ret < 0) {
-            if (ret == AVERROR_EOF) {
-                lock_state(player);
-                if (player->loop && !player->is_live) {
-                    /* Loop back to start */
-                    av_seek_frame(player->format_ctx, -1, 0, AVSEEK_FLAG_BACKWARD);
-                    if (player->video_codec_ctx) avcodec_flush_buffers(player->video_codec_ctx);
-                    if (player->audio_codec_ctx) avcodec_flush_buffers(player->audio_codec_ctx);
-                    player->playback_start_time = av_gettime();
-                    player->start_pts = 0;
-                    player->current_pts = 0;
-                    player->first_frame_decoded = false;
-                    player->first_frame_displayed = false;
-                    unlock_state(player);
-                    continue;
-                } else {
-                    player->state = PRISM_STATE_END_OF_FILE;
-                    unlock_state(player);
-                    break;
-                }
-            }
-            /* Other error or EAGAIN, just continue */
-            av_packet_unref(packet);
-            continue;
+/* Wake every pipeline thread to re-check player state */
+static void wake_pipeline(PrismPlayer* player) {
+    event_signal(&player->demux_wake);
+    event_signal(&player->video_wake);
+    event_signal(&player->audio_wake);
+}
+
+/* ============================================================================
+ * Audio Ring
+ *
+ * Same publication scheme as the video frame ring, with samples copied in at
+ * most two memcpy segments per side. The host may pull audio from a real-time
+ * thread, so the read side never blocks.
+ * ========================================================================== */
+
+static unsigned int round_up_pow2(unsigned int value) {
+    unsigned int result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+/* Samples buffered, as seen by the producer */
+static unsigned int audio_ring_count(PrismPlayer* player) {
+    return player->audio_write_pos - load_acquire(&player->audio_read_pos);
+}
+
+/* Producer: append up to count samples, dropping what does not fit.
+ * Returns the number of samples written. */
+static int audio_ring_write(PrismPlayer* player, const float* samples, int count) {
+    unsigned int write = player->audio_write_pos;
+    unsigned int space = player->audio_buffer_size - (write - load_acquire(&player->audio_read_pos));
+    unsigned int total = ((unsigned int)count < space) ? (unsigned int)count : space;
+
+    unsigned int offset = write & (player->audio_buffer_size - 1);
+    unsigned int first = player->audio_buffer_size - offset;
+    if (first > total) {
+        first = total;
+    }
+    memcpy(player->audio_buffer + offset, samples, first * sizeof(float));
+    memcpy(player->audio_buffer, samples + first, (total - first) * sizeof(float));
+
+    store_release(&player->audio_write_pos, write + total);
+    return (int)total;
+}
+
+/* Consumer: copy out up to max_samples. Never blocks. */
+static int audio_ring_read(PrismPlayer* player, float* buffer, int max_samples) {
+    unsigned int read = player->audio_read_pos;
+
+    /* Apply a pending flush from Stop/Seek (never rewinds) */
+    if (atomic_exchange(&player->audio_flush, 0)) {
+        unsigned int flush_pos = load_acquire(&player->audio_flush_pos);
+        if ((int)(flush_pos - read) > 0) {
+            read = flush_pos;
         }
+    }
 
-        /* Video packet */
-        if (packet->stream_index == player->video_stream_idx && player->video_codec_ctx) {
-            ret = avcodec_send_packet(player->video_codec_ctx, packet);
-            if (ret >= 0) {
-                ret = avcodec_receive_frame(player->video_codec_ctx, frame);
-                if (ret >= 0) {
-                    /* Get frame PTS */
-                    double frame_pts = 0;
-                    if (frame->pts != AV_NOPTS_VALUE) {
-                        frame_pts = frame->pts * player->video_time_base;
-                    } else if (frame->best_effort_timestamp != AV_NOPTS_VALUE) {
-                        frame_pts = frame->best_effort_timestamp * player->video_time_base;
-                    }
+    unsigned int available = load_acquire(&player->audio_write_pos) - read;
+    unsigned int total = ((unsigned int)max_samples < available) ? (unsigned int)max_samples : available;
 
-                    /* Mark that we have decoded frames (clock sync happens on display) */
-                    lock_state(player);
-                    if (!player->first_frame_decoded) {
-                        player->first_frame_decoded = true;
-                        prism_log(1, "First video frame decoded, PTS: %.3f", frame_pts);
-                    }
-                    unlock_state(player);
-
-                    /* Convert to RGBA */
-                    sws_scale(player->sws_ctx,
-                        (const uint8_t* const*)frame->data, frame->linesize,
-                        0, player->video_height,
-                        player->rgb_frame->data, player->rgb_frame->linesize);
-
-                    /* Add to video queue */
-                    lock_queue(player);
-                    if (player->video_queue_count < VIDEO_QUEUE_SIZE) {
-                        int idx = player->video_queue_write;
-                        VideoFrameEntry* entry = &player->video_queue[idx];
-
-                        /* Allocate buffer if needed */
-                        int frame_size = player->video_width * player->video_height * 4;
-                        if (!entry->data) {
-                            entry->data = (uint8_t*)av_malloc(frame_size);
-                        }
-
-                        /* Copy frame data */
-                        memcpy(entry->data, player->rgb_frame->data[0], frame_size);
-                        entry->width = player->video_width;
-                        entry->height = player->video_height;
-                        entry->stride = player->video_stride;
-                        entry->pts = frame_pts;
-                        entry->valid = true;
-
-                        player->video_queue_write = (player->video_queue_write + 1) % VIDEO_QUEUE_SIZE;
-                        player->video_queue_count++;
-                    }
-                    unlock_queue(player);
+    unsigned int offset = read & (player->audio_buffer_size - 1);
+    unsigned int first = player->audio_buffer_size - offset;
+    if (first > total) {
+        first = total;
+    }
+    memcpy(buffer, player->audio_buffer + offset, first * sizeof(float));
+    memcpy(buffer + first, player->audio_buffer, (total - first) * sizeof(float));
 
-                    /* Update current PTS */
-                    lock_state(player);
-                    player->video_pts = frame_pts;
-                    player->current_pts = frame_pts;
-                    unlock_state(player);
-                }
-            }
+    store_release(&player->audio_read_pos, read + total);
+    return (int)total;
+}
+
+/* Discard audio buffered so far. Safe from any thread; the read position
+ * belongs to the consumer, so it is asked to skip ahead instead. */
+static void audio_ring_flush(PrismPlayer* player) {
+    store_release(&player->audio_flush_pos, load_acquire(&player->audio_write_pos));
+    store_release(&player->audio_flush, 1);
+}
+
+/* ============================================================================
+ * Video Frame Ring
+ *
+ * The video decode thread fills a slot and then publishes it by advancing the
+ * write index (release); the update thread observes it (acquire), consumes
+ * the slot and hands it back by advancing the read index (release). Neither
+ * side ever takes a lock, and slot data is never touched by both at once.
+ * ========================================================================== */
+
+/* Number of frames currently queued (safe from either side) */
+static int video_ring_count(PrismPlayer* player) {
+    unsigned int read = load_acquire(&player->video_queue_read);
+    unsigned int write = load_acquire(&player->video_queue_write);
+    return (int)(write - read);
+}
+
+/* Producer: get the next free slot, or NULL if the ring is full */
+static VideoFrameEntry* video_ring_write_slot(PrismPlayer* player) {
+    unsigned int write = player->video_queue_write;
+    unsigned int read = load_acquire(&player->video_queue_read);
+    if (write - read >= VIDEO_QUEUE_SIZE) {
+        return NULL;
+    }
+    return &player->video_queue[write & (VIDEO_QUEUE_SIZE - 1)];
+}
+
+/* Producer: publish the slot returned by video_ring_write_slot */
+static void video_ring_commit(PrismPlayer* player) {
+    store_release(&player->video_queue_write, player->video_queue_write + 1);
+}
+
+/* Consumer: get the oldest queued frame, or NULL if the ring is empty */
+static VideoFrameEntry* video_ring_peek(PrismPlayer* player) {
+    unsigned int read = player->video_queue_read;
+    unsigned int write = load_acquire(&player->video_queue_write);
+    if (read == write) {
+        return NULL;
+    }
+    return &player->video_queue[read & (VIDEO_QUEUE_SIZE - 1)];
+}
+
+/* Consumer: release the slot returned by video_ring_peek back to the producer */
+static void video_ring_pop(PrismPlayer* player) {
+    store_release(&player->video_queue_read, player->video_queue_read + 1);
+    event_signal(&player->video_wake);
+}
+
+/* Consumer: drop the oldest queued frame, returning its buffers */
+static void video_ring_discard(PrismPlayer* player) {
+    VideoFrameEntry* entry = video_ring_peek(player);
+    if (entry) {
+        av_frame_unref(entry->frame);
+        video_ring_pop(player);
+    }
+}
+
+/* Drop all queued frames. Only valid while the pipeline threads are stopped. */
+static void video_ring_reset(PrismPlayer* player) {
+    for (int i = 0; i < VIDEO_QUEUE_SIZE; i++) {
+        if (player->video_queue[i].frame) {
+            av_frame_unref(player->video_queue[i].frame);
         }
+    }
+    store_release(&player->video_queue_write, 0);
+    store_release(&player->video_queue_read, 0);
+}
 
-        /* Audio packet */
-        if (packet->stream_index == player->audio_stream_idx && player->audio_codec_ctx) {
-            ret = avcodec_send_packet(player->audio_codec_ctx, packet);
-            if (ret >= 0) {
-                AVFrame* audio_frame = av_frame_alloc();
-                ret = avcodec_receive_frame(player->audio_codec_ctx, audio_frame);
-                if (ret >= 0 && player->swr_ctx) {
-                    /* Get audio PTS */
-                    if (audio_frame->pts != AV_NOPTS_VALUE) {
-                        lock_state(player);
-                        player->audio_pts = audio_frame->pts * player->audio_time_base;
-                        unlock_state(player);
-                    }
+/* This player's share of the core budget */
+static int core_share(void) {
+    int budget = g_core_budget > 0 ? g_core_budget : av_cpu_count();
+    int players = (int)load_acquire(&g_player_count);
+    int share = budget / (players > 0 ? players : 1);
+    return share < 1 ? 1 : share;
+}
 
-                    /* Convert to float samples */
-                    int out_samples = swr_get_out_samples(player->swr_ctx, audio_frame->nb_samples);
-                    float* temp_buffer = (float*)av_malloc(out_samples * 2 * sizeof(float));
-                    uint8_t* out_ptr = (uint8_t*)temp_buffer;
-
-                    int samples_converted = swr_convert(player->swr_ctx,
-                        &out_ptr, out_samples,
-                        (const uint8_t**)audio_frame->data, audio_frame->nb_samples);
-
-                    if (samples_converted > 0) {
-                        /* Write to audio ring buffer */
-                        lock_queue(player);
-                        int total_samples = samples_converted * 2;
-                        for (int i = 0; i < total_samples; i++) {
-                            if (player->audio_available < player->audio_buffer_size) {
-                                player->audio_buffer[player->audio_write_pos] = temp_buffer[i];
-                                player->audio_write_pos = (player->audio_write_pos + 1) % player->audio_buffer_size;
-                                player->audio_available++;
-                            }
-                        }
-                        unlock_queue(player);
-                    }
-                    av_free(temp_buffer);
-                }
-                av_frame_free(&audio_frame);
+/* Color conversion threads: explicit, or a quarter of the player's share */
+static int resolve_convert_threads(PrismPlayer* player) {
+    if (player->convert_thread_count > 0) {
+        return player->convert_thread_count;
+    }
+    int thread_count = core_share() / CONVERT_SHARE_DIVISOR;
+    return thread_count < 1 ? 1 : thread_count;
+}
+
+/* Decoder threads: explicit, or the player's share less the conversion threads,
+ * which run alongside the decoder's */
+static int resolve_decode_threads(PrismPlayer* player) {
+    if (player->decode_thread_count > 0) {
+        return player->decode_thread_count;
+    }
+    int thread_count = core_share() - resolve_convert_threads(player);
+    return thread_count < 1 ? 1 : thread_count;
+}
+
+/* Apply the player's threading policy to a video codec context before avcodec_open2.
+ * With no explicit count, each open player gets an equal share of the process-wide
+ * core budget, split between decoding and conversion, so one player uses the
+ * whole machine and a video wall doesn't oversubscribe it. */
+static void configure_decode_threads(PrismPlayer* player, AVCodecContext* codec_ctx, const AVCodec* codec) {
+    int thread_count = resolve_decode_threads(player);
+
+    int thread_type = 0;
+    switch (player->decode_thread_mode) {
+        case PRISM_THREAD_MODE_FRAME:
+            thread_type = FF_THREAD_FRAME;
+            break;
+        case PRISM_THREAD_MODE_SLICE:
+            thread_type = FF_THREAD_SLICE;
+            break;
+        case PRISM_THREAD_MODE_AUTO:
+        default:
+            /* Frame threading delays output by one frame per thread; live
+             * streams prefer slice threading where the codec supports it */
+            if (player->is_live && (codec->capabilities & AV_CODEC_CAP_SLICE_THREADS)) {
+                thread_type = FF_THREAD_SLICE;
+            } else {
+                thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
             }
-        }
+            break;
+    }
 
-        av_packet_unref(packet);
+    codec_ctx->thread_count = thread_count;
+    codec_ctx->thread_type = thread_type;
+}
+
+/* Map the public output format to the FFmpeg pixel format we hand out */
+static enum AVPixelFormat get_output_pix_fmt(PrismPixelFormat format) {
+    switch (format) {
+        case PRISM_PIXEL_FORMAT_BGRA:    return AV_PIX_FMT_BGRA;
+        case PRISM_PIXEL_FORMAT_RGB24:   return AV_PIX_FMT_RGB24;
+        case PRISM_PIXEL_FORMAT_YUV420P: return AV_PIX_FMT_YUV420P;
+        case PRISM_PIXEL_FORMAT_NV12:    return AV_PIX_FMT_NV12;
+        case PRISM_PIXEL_FORMAT_RGBA:
+        default:                         return AV_PIX_FMT_RGBA;
     }
+}
 
-    av_packet_free(&packet);
-    av_frame_free(&frame);
-    av_frame_free(&rgb_frame);
+/* Create the conversion context from src_width x src_height src_fmt to the
+ * output size and format. libswscale splits each frame into horizontal
+ * slices and converts them on its own worker pool when the "threads"
+ * option is above one; falls back to a single-threaded context. */
+static struct SwsContext* create_sws_context(PrismPlayer* player, int src_width, int src_height,
+    enum AVPixelFormat src_fmt, enum AVPixelFormat dst_fmt) {
+    int thread_count = resolve_convert_threads(player);
+
+    player->sws_src_width = src_width;
+    player->sws_src_height = src_height;
+    player->sws_src_format = src_fmt;
+
+    struct SwsContext* ctx = sws_alloc_context();
+    if (ctx) {
+        av_opt_set_int(ctx, "srcw", src_width, 0);
+        av_opt_set_int(ctx, "srch", src_height, 0);
+        av_opt_set_int(ctx, "src_format", src_fmt, 0);
+        av_opt_set_int(ctx, "dstw", player->video_width, 0);
+        av_opt_set_int(ctx, "dsth", player->video_height, 0);
+        av_opt_set_int(ctx, "dst_format", dst_fmt, 0);
+        av_opt_set_int(ctx, "sws_flags", SWS_BILINEAR, 0);
+        if (av_opt_set_int(ctx, "threads", thread_count, 0) < 0) {
+            thread_count = 1;
+        }
+        if (sws_init_context(ctx, NULL, NULL) >= 0) {
+            player->convert_threads = thread_count;
+            return ctx;
+        }
+        sws_freeContext(ctx);
+    }
 
-    prism_log(1, "Decoder thread stopped");
+    player->convert_threads = 1;
+    return sws_getContext(
+        src_width, src_height, src_fmt,
+        player->video_width, player->video_height, dst_fmt,
+        SWS_BILINEAR, NULL, NULL, NULL
+    );
+}
 
-#ifdef _WIN32
-    return 0;
-#else
-    return NULL;
-#endif
+/* Decoded frames already in the output layout are queued as-is.
+ * YUVJ420P is YUV420P with full range, which get_video_planes reports. */
+static bool is_passthrough_format(PrismPlayer* player, int format) {
+    if (format == player->video_dst_fmt) {
+        return true;
+    }
+    return player->video_dst_fmt == AV_PIX_FMT_YUV420P && format == AV_PIX_FMT_YUVJ420P;
 }
 
-static void start_decoder_thread(PrismPlayer* player) {
-    if (player->decoder_running) {
+/* Shrink width x height to fit inside max_width x max_height, keeping the
+ * aspect ratio. Never enlarges; fitted sizes are kept even for 4:2:0 output. */
+static void fit_output_size(int max_width, int max_height, int* width, int* height) {
+    if (max_width <= 0 || max_height <= 0 || (*width <= max_width && *height <= max_height)) {
         return;
     }
 
-#ifdef _WIN32
-    player->stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
-    player->decoder_thread = CreateThread(NULL, 0, decoder_thread_func, player, 0, NULL);
-#else
-    player->stop_requested = false;
-    pthread_create(&player->decoder_thread, NULL, decoder_thread_func, player);
-#endif
+    int64_t w = *width;
+    int64_t h = *height;
+    if (w * max_height > h * max_width) {
+        h = h * max_width / w;
+        w = max_width;
+    } else {
+        w = w * max_height / h;
+        h = max_height;
+    }
+    *width = FFMAX(2, (int)w & ~1);
+    *height = FFMAX(2, (int)h & ~1);
+}
 
-    player->decoder_running = true;
-    prism_log(1, "Started decoder thread");
+/* Output size for a source frame: the source size (while adaptive, the
+ * largest variant's), fitted inside the requested output size */
+static void get_output_size(PrismPlayer* player, const AVFrame* src, int* width, int* height) {
+    if (player->abr_variant_count > 0) {
+        *width = player->abr_output_width;
+        *height = player->abr_output_height;
+    } else {
+        *width = src->width;
+        *height = src->height;
+    }
+
+    lock_state(player);
+    int max_width = player->output_max_width;
+    int max_height = player->output_max_height;
+    unlock_state(player);
+    fit_output_size(max_width, max_height, width, height);
 }
 
-static void stop_decoder_thread(PrismPlayer* player) {
-    if (!player->decoder_running) {
+/* Row alignment of converted frames. Packed RGBA/BGRA rows are aligned to
+ * PRISM_FRAME_ALIGN only when width * 4 is a multiple of it already, so
+ * their stride is always width * 4 and the C# player uploads them as-is.
+ * Planar output keeps aligned rows. */
+static int frame_align(enum AVPixelFormat fmt, int width) {
+    if (fmt == AV_PIX_FMT_RGBA || fmt == AV_PIX_FMT_BGRA) {
+        return (width * 4) % PRISM_FRAME_ALIGN == 0 ? PRISM_FRAME_ALIGN : 1;
+    }
+    return PRISM_FRAME_ALIGN;
+}
+
+/* The output size changed mid-stream (new SPS, resolution change, new
+ * requested output size): later frames get buffers from the pool of the new
+ * size. Frames still queued or displayed keep their buffers, which go back
+ * to the old pool. */
+static bool resize_output(PrismPlayer* player, int width, int height) {
+    int size = av_image_get_buffer_size(player->video_dst_fmt, width, height,
+        frame_align(player->video_dst_fmt, width));
+    if (size <= 0) {
+        return false;
+    }
+
+    lock_state(player);
+    prism_log(1, "Video: output size %dx%d -> %dx%d", player->video_width, player->video_height, width, height);
+    player->video_width = width;
+    player->video_height = height;
+    if (size != player->frame_buffer_size) {
+        prism_frame_pool_release(&player->frame_pool);
+        player->frame_pool = prism_frame_pool_get(size);
+        player->frame_buffer_size = size;
+    }
+    player->sws_src_width = 0;
+    unlock_state(player);
+
+    return player->frame_pool != NULL;
+}
+
+/* Forward declarations */
+static void start_convert_workers(PrismPlayer* player);
+static void convert_in_bands(PrismPlayer* player, const AVFrame* src, AVFrame* dst);
+
+/* Rebuild the conversion when the source size or pixel format differs from
+ * what it was set up for: a mid-stream change, an ABR variant, or the first
+ * frame when probing was skipped. Unchanged frames cost one comparison. */
+static void update_converter(PrismPlayer* player, const AVFrame* src) {
+    if (src->width == player->sws_src_width && src->height == player->sws_src_height &&
+        src->format == player->sws_src_format) {
         return;
     }
 
-#ifdef _WIN32
-    SetEvent(player->stop_event);
-    WaitForSingleObject(player->decoder_thread, 2000);
-    CloseHandle(player->decoder_thread);
-    CloseHandle(player->stop_event);
-    player->decoder_thread = NULL;
-    player->stop_event = NULL;
-#else
     lock_state(player);
-    player->stop_requested = true;
+    sws_freeContext(player->sws_ctx);
+    player->sws_ctx = create_sws_context(player, src->width, src->height,
+        (enum AVPixelFormat)src->format, player->video_dst_fmt);
+    player->use_yuv_kernel = prism_yuv_kernel_init(&player->yuv_kernel,
+        (enum AVPixelFormat)src->format, player->video_dst_fmt, av_get_cpu_flags());
     unlock_state(player);
-    pthread_join(player->decoder_thread, NULL);
-#endif
 
-    player->decoder_running = false;
-    prism_log(1, "Stopped decoder thread");
+    start_convert_workers(player);
+}
+
+/* Produce an output frame in dst: either a new reference to the decoded
+ * frame (native format, no conversion) or sws_scale output written straight
+ * into a pooled buffer. Returns 0 on success. */
+static int convert_video_frame(PrismPlayer* player, AVFrame* src, AVFrame* dst) {
+    int out_width, out_height;
+    get_output_size(player, src, &out_width, &out_height);
+    if ((out_width != player->video_width || out_height != player->video_height) &&
+        !resize_output(player, out_width, out_height)) {
+        return AVERROR(ENOMEM);
+    }
+
+    bool same_size = src->width == out_width && src->height == out_height;
+    if (same_size && is_passthrough_format(player, src->format)) {
+        return av_frame_ref(dst, src);
+    }
+
+    update_converter(player, src);
+    bool use_kernel = player->use_yuv_kernel && same_size;
+    if (!use_kernel && !player->sws_ctx) {
+        return AVERROR(EINVAL);
+    }
+
+    AVBufferRef* buf = av_buffer_pool_get(player->frame_pool);
+    if (!buf) {
+        return AVERROR(ENOMEM);
+    }
+
+    av_image_fill_arrays(dst->data, dst->linesize, buf->data,
+        player->video_dst_fmt, player->video_width, player->video_height,
+        frame_align(player->video_dst_fmt, player->video_width));
+    dst->buf[0] = buf;
+    dst->format = player->video_dst_fmt;
+    dst->width = player->video_width;
+    dst->height = player->video_height;
+    dst->colorspace = src->colorspace;
+    dst->color_range = (src->format == AV_PIX_FMT_YUVJ420P) ? AVCOL_RANGE_JPEG : src->color_range;
+
+    /* Common 4:2:0 -> RGBA/BGRA pairs use the SIMD kernels, in one band per
+     * conversion thread; everything else goes through sws_scale_frame, which
+     * runs the slices in parallel on threaded contexts. Single-threaded
+     * contexts use sws_scale, which needs no frame refs. */
+    int64_t start = av_gettime_relative();
+    int ret = 0;
+    if (use_kernel) {
+        convert_in_bands(player, src, dst);
+    } else if (player->convert_threads > 1) {
+        ret = sws_scale_frame(player->sws_ctx, dst, src);
+    } else {
+        ret = sws_scale(player->sws_ctx,
+            (const uint8_t* const*)src->data, src->linesize,
+            0, src->height,
+            dst->data, dst->linesize);
+    }
+    double elapsed_ms = (av_gettime_relative() - start) / 1000.0;
+    if (ret < 0) {
+        av_frame_unref(dst);
+        return ret;
+    }
+
+    lock_state(player);
+    player->frames_converted++;
+    player->convert_ms_last = elapsed_ms;
+    player->convert_ms_total += elapsed_ms;
+    if (elapsed_ms > player->convert_ms_max) {
+        player->convert_ms_max = elapsed_ms;
+    }
+    unlock_state(player);
+
+    return 0;
 }
 
 /* ============================================================================
- * Initialization
+ * Packet Queues
+ *
+ * Bounded rings of preallocated packets between the demux thread and one
+ * decode thread, using the same single-producer/single-consumer publication
+ * as the video frame ring.
  * ========================================================================== */
 
-PRISM_API int prism_init(void) {
-    if (g_initialized) {
-        return PRISM_OK;
+static bool packet_queue_init(PacketQueue* queue, unsigned int capacity) {
+    queue->entries = (PacketQueueEntry*)av_calloc(capacity, sizeof(PacketQueueEntry));
+    if (!queue->entries) {
+        return false;
     }
+    queue->capacity = capacity;
+    for (unsigned int i = 0; i < capacity; i++) {
+        queue->entries[i].packet = av_packet_alloc();
+        if (!queue->entries[i].packet) {
+            return false;
+        }
+    }
+    store_release(&queue->write, 0);
+    store_release(&queue->read, 0);
+    return true;
+}
 
-    /* FFmpeg 4.0+ doesn't require av_register_all() */
-    avformat_network_init();
+static void packet_queue_free(PacketQueue* queue) {
+    if (queue->entries) {
+        for (unsigned int i = 0; i < queue->capacity; i++) {
+            av_packet_free(&queue->entries[i].packet);
+        }
+        av_freep(&queue->entries);
+    }
+    queue->capacity = 0;
+}
 
-    g_initialized = true;
-    prism_log(1, "Prism FFmpeg initialized. FFmpeg version: %s", av_version_info());
+/* Producer: move packet (may be NULL for markers) into the queue.
+ * Returns false if the queue is full. */
+static bool packet_queue_put(PacketQueue* queue, AVPacket* packet, PacketKind kind,
+    unsigned int serial, double seek_target) {
+    unsigned int write = queue->write;
+    unsigned int read = load_acquire(&queue->read);
+    if (write - read >= queue->capacity) {
+        return false;
+    }
 
-    return PRISM_OK;
+    PacketQueueEntry* entry = &queue->entries[write & (queue->capacity - 1)];
+    entry->kind = kind;
+    entry->serial = serial;
+    entry->seek_target = seek_target;
+    if (packet) {
+        av_packet_move_ref(entry->packet, packet);
+    }
+    store_release(&queue->write, write + 1);
+    return true;
 }
 
-PRISM_API void prism_shutdown(void) {
-    if (!g_initialized) {
-        return;
-    }
+/* Number of queued entries (safe from either side) */
+static unsigned int packet_queue_count(PacketQueue* queue) {
+    return load_acquire(&queue->write) - load_acquire(&queue->read);
+}
 
+/* Consumer: get the oldest entry, or NULL if the queue is empty */
+static PacketQueueEntry* packet_queue_peek(PacketQueue* queue) {
+    unsigned int read = queue->read;
+    unsigned int write = load_acquire(&queue->write);
+    if (read == write) {
+        return NULL;
+    }
+    return &queue->entries[read & (queue->capacity - 1)];
+}
+
+/* Consumer: release the entry returned by packet_queue_peek */
+static void packet_queue_pop(PacketQueue* queue) {
+    unsigned int read = queue->read;
+    av_packet_unref(queue->entries[read & (queue->capacity - 1)].packet);
+    store_release(&queue->read, read + 1);
+}
+
+/* Drop all queued packets. Only valid while the pipeline threads are stopped. */
+static void packet_queue_reset(PacketQueue* queue) {
+    for (unsigned int i = 0; i < queue->capacity; i++) {
+        av_packet_unref(queue->entries[i].packet);
+    }
+    store_release(&queue->write, 0);
+    store_release(&queue->read, 0);
+}
+
+/* ============================================================================
+ * Pipeline Threads
+ *
+ * demux thread --> video packet queue --> video decode thread --> frame ring
+ *              \-> audio packet queue --> audio decode thread --> audio ring
+ *
+ * Every stage blocks when the next one is full instead of dropping data, so a
+ * slow video frame or a stalled read no longer starves the other stream.
+ * Blocked threads sleep on their wakeup event; whoever frees space, queues
+ * work or changes state signals it, so idle players use no CPU.
+ * ========================================================================== */
+
+static bool should_stop(PrismPlayer* player) {
+    return load_acquire(&player->stop_requested) != 0;
+}
+
+/* Interrupt callback of the demuxer and the I/O it opens: a read blocked
+ * on the network returns once the pipeline is told to stop */
+static int demux_interrupt(void* opaque) {
+    return should_stop((PrismPlayer*)opaque);
+}
+
+/* True if work tagged with serial predates the newest Seek/Stop */
+static bool is_stale(PrismPlayer* player, unsigned int serial) {
+    return serial != load_acquire(&player->serial);
+}
+
+/* Event signalled when a packet is queued for this queue's decoder */
+static PrismEvent* queue_consumer_wake(PrismPlayer* player, PacketQueue* queue) {
+    return (queue == &player->video_packets) ? &player->video_wake : &player->audio_wake;
+}
+
+static bool thread_create(prism_thread_t* thread, prism_thread_ret_t (PRISM_THREAD_CALL *func)(void*), void* arg) {
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, func, arg, 0, NULL);
+    return *thread != NULL;
+#else
+    return pthread_create(thread, NULL, func, arg) == 0;
+#endif
+}
+
+static void thread_join(prism_thread_t* thread) {
+#ifdef _WIN32
+    WaitForSingleObject(*thread, INFINITE);
+    CloseHandle(*thread);
+    *thread = NULL;
+#else
+    pthread_join(*thread, NULL);
+#endif
+}
+
+/* ============================================================================
+ * Conversion Bands
+ *
+ * With more than one conversion thread the SIMD kernel converts a frame in
+ * horizontal bands, one per thread, like swscale's slices. Bands start on
+ * even rows, so 4:2:0 chroma rows are never shared between two of them.
+ * ========================================================================== */
+
+/* First row of band index out of count; the band past the last is height */
+static int band_row(int height, int index, int count) {
+    if (index >= count) {
+        return height;
+    }
+    return (int)((int64_t)height * index / count) & ~1;
+}
+
+static void convert_band(PrismPlayer* player, int index) {
+    int height = player->convert_dst->height;
+    prism_yuv_kernel_convert(&player->yuv_kernel, player->convert_src, player->convert_dst,
+        band_row(height, index, player->convert_bands), band_row(height, index + 1, player->convert_bands));
+}
+
+static prism_thread_ret_t PRISM_THREAD_CALL convert_worker_func(void* arg) {
+    ConvertWorker* worker = (ConvertWorker*)arg;
+    PrismPlayer* player = worker->player;
+    unsigned int converted = 0;
+
+    while (1) {
+        unsigned int seq = event_seq(&player->convert_wake);
+        if (load_acquire(&player->convert_stop)) {
+            break;
+        }
+        unsigned int posted = load_acquire(&player->convert_posted);
+        if (posted == converted) {
+            event_wait(&player->convert_wake, seq, -1);
+            continue;
+        }
+
+        converted = posted;
+        convert_band(player, worker->band);
+        if (atomic_add(&player->convert_pending, -1) == 0) {
+            event_signal(&player->convert_done);
+        }
+    }
+    return 0;
+}
+
+/* Start a worker per band beyond the first once the kernel is in use. If a
+ * thread cannot be created, frames are split into fewer bands. */
+static void start_convert_workers(PrismPlayer* player) {
+    int count = player->convert_threads - 1;
+    if (!player->use_yuv_kernel || count < 1 || player->convert_workers) {
+        return;
+    }
+
+    player->convert_workers = (ConvertWorker*)calloc(count, sizeof(ConvertWorker));
+    if (!player->convert_workers) {
+        return;
+    }
+    store_release(&player->convert_stop, 0);
+    store_release(&player->convert_posted, 0);
+
+    int started = 0;
+    while (started < count) {
+        ConvertWorker* worker = &player->convert_workers[started];
+        worker->player = player;
+        worker->band = started + 1;
+        if (!thread_create(&worker->thread, convert_worker_func, worker)) {
+            prism_log(1, "Video: could not start conversion worker %d of %d", started + 1, count);
+            break;
+        }
+        started++;
+    }
+    player->convert_worker_count = started;
+    player->convert_bands = started + 1;
+}
+
+static void stop_convert_workers(PrismPlayer* player) {
+    if (!player->convert_workers) {
+        return;
+    }
+
+    store_release(&player->convert_stop, 1);
+    event_signal(&player->convert_wake);
+    for (int i = 0; i < player->convert_worker_count; i++) {
+        thread_join(&player->convert_workers[i].thread);
+    }
+    free(player->convert_workers);
+    player->convert_workers = NULL;
+    player->convert_worker_count = 0;
+    player->convert_bands = 1;
+}
+
+/* Convert src into dst with the SIMD kernel: post the frame to the workers,
+ * convert the first band here and wait for the rest */
+static void convert_in_bands(PrismPlayer* player, const AVFrame* src, AVFrame* dst) {
+    if (player->convert_bands <= 1) {
+        prism_yuv_kernel_convert(&player->yuv_kernel, src, dst, 0, dst->height);
+        return;
+    }
+
+    player->convert_src = src;
+    player->convert_dst = dst;
+    store_release(&player->convert_pending, (unsigned int)player->convert_worker_count);
+    atomic_add(&player->convert_posted, 1);
+    event_signal(&player->convert_wake);
+
+    convert_band(player, 0);
+
+    while (1) {
+        unsigned int seq = event_seq(&player->convert_done);
+        if (load_acquire(&player->convert_pending) == 0) {
+            break;
+        }
+        event_wait(&player->convert_done, seq, -1);
+    }
+}
+
+/* Queue a packet or marker, waiting while the decoder catches up.
+ * Returns false if the pipeline is stopping or a newer command was posted
+ * (the packet would be discarded anyway). */
+static bool packet_queue_put_wait(PrismPlayer* player, PacketQueue* queue, AVPacket* packet, PacketKind kind) {
+    while (1) {
+        unsigned int seq = event_seq(&player->demux_wake);
+        if (packet_queue_put(queue, packet, kind, player->demux_serial, player->demux_seek_target)) {
+            break;
+        }
+        if (should_stop(player) || is_stale(player, player->demux_serial)) {
+            return false;
+        }
+        event_wait(&player->demux_wake, seq, -1);
+    }
+    event_signal(queue_consumer_wake(player, queue));
+    return true;
+}
+
+/* Queue an audio packet, waiting while the decoder catches up as video
+ * does. While prerolling audio is not consumed, so once its queue is full
+ * and the video decoder runs dry the packet is dropped rather than stall
+ * video behind it. Returns false if the pipeline is stopping or a newer
+ * command was posted. */
+static bool queue_audio_packet(PrismPlayer* player, AVPacket* packet, bool prerolling) {
+    while (1) {
+        unsigned int seq = event_seq(&player->demux_wake);
+        if (packet_queue_put(&player->audio_packets, packet, PACKET_DATA, player->demux_serial, -1.0)) {
+            break;
+        }
+        if (should_stop(player) || is_stale(player, player->demux_serial)) {
+            return false;
+        }
+        if (prerolling && player->video_codec_ctx && packet_queue_count(&player->video_packets) == 0) {
+            av_packet_unref(packet);
+            return true;
+        }
+        event_wait(&player->demux_wake, seq, -1);
+    }
+    event_signal(&player->audio_wake);
+    return true;
+}
+
+/* Send a FLUSH, EOF or SEEK marker to every active decoder */
+static bool queue_marker(PrismPlayer* player, PacketKind kind) {
+    if (player->video_codec_ctx && !packet_queue_put_wait(player, &player->video_packets, NULL, kind)) {
+        return false;
+    }
+    if (player->audio_codec_ctx && !packet_queue_put_wait(player, &player->audio_packets, NULL, kind)) {
+        return false;
+    }
+    return true;
+}
+
+/* Called by each decode thread once it has consumed the EOF marker.
+ * Playback has ended when every active decoder is done. */
+static void mark_decoder_eof(PrismPlayer* player, bool is_video) {
+    lock_state(player);
+    if (is_video) {
+        player->video_eof = true;
+    } else {
+        player->audio_eof = true;
+    }
+    bool video_done = !player->video_codec_ctx || player->video_eof;
+    bool audio_done = !player->audio_codec_ctx || player->audio_eof;
+    bool active = player->state == PRISM_STATE_PLAYING || player->state == PRISM_STATE_PAUSED;
+    if (video_done && audio_done && active) {
+        player->state = PRISM_STATE_END_OF_FILE;
+    }
+    unlock_state(player);
+}
+
+/* Demux thread: apply the queued Seek/Stop commands. Each one supersedes
+ * those before it, so only the newest is carried out. The decoders flush
+ * when they reach its SEEK marker; nothing is stopped or joined. */
+static void process_commands(PrismPlayer* player) {
+    lock_state(player);
+    if (player->command_count == 0) {
+        unlock_state(player);
+        return;
+    }
+    PrismCommand command = player->commands[player->command_count - 1];
+    player->command_count = 0;
+    player->first_frame_decoded = false;
+    unlock_state(player);
+
+    int64_t timestamp = (int64_t)(command.position * AV_TIME_BASE);
+    if (av_seek_frame(player->format_ctx, -1, timestamp, AVSEEK_FLAG_BACKWARD) < 0) {
+        /* Decoders still flush, playback continues from the current position */
+        prism_log(1, "Seek to %.3f failed", command.position);
+    }
+
+    /* Exact mode: decode forward from the keyframe, discarding up to the target */
+    bool exact = (command.type == COMMAND_SEEK && command.mode == PRISM_SEEK_EXACT);
+    player->demux_serial = command.serial;
+    player->demux_seek_target = exact ? command.position : -1.0;
+    queue_marker(player, PACKET_SEEK);
+    player->demux_seek_target = -1.0;
+
+    store_release(&player->completed_serial, command.serial);
+    prism_log(1, "Applied %s command %u at %.3f",
+        command.type == COMMAND_STOP ? "stop" : "seek", command.serial, command.position);
+}
+
+/* Demux thread: finish prerolling once the watermark's worth of media has
+ * been queued (packet_time is the queued packet's time in seconds) */
+static void update_preroll(PrismPlayer* player, double packet_time) {
+    lock_state(player);
+    if (!player->preroll_started) {
+        player->preroll_started = true;
+        player->preroll_start = packet_time;
+    } else if (packet_time - player->preroll_start >= player->preroll_seconds) {
+        player->prerolling = false;
+        player->preroll_done = true;
+        prism_log(1, "Preroll done: %.3f s queued", packet_time - player->preroll_start);
+    }
+    unlock_state(player);
+}
+
+/* Demux thread: merge the finished background index into the demuxer, so
+ * seeks land on a keyframe instead of scanning */
+static void apply_keyframe_index(PrismPlayer* player) {
+    int added = prism_index_apply(&player->keyframe_index, player->format_ctx);
+
+    lock_state(player);
+    player->index_keyframes = added;
+    unlock_state(player);
+
+    store_release(&player->index_state, INDEX_APPLIED);
+    prism_log(1, "Keyframe index: merged %d entries", added);
+}
+
+/* Make the demuxer read only the current variant's streams. HLS starts a
+ * newly enabled playlist at the segment holding the current position. */
+static void apply_variant_discard(PrismPlayer* player) {
+    AVFormatContext* fmt = player->format_ctx;
+    for (int i = 0; i < player->abr_variant_count; i++) {
+        const AbrVariant* variant = &player->abr_variants[i];
+        fmt->streams[variant->video_stream]->discard = AVDISCARD_ALL;
+        if (variant->audio_stream >= 0) {
+            fmt->streams[variant->audio_stream]->discard = AVDISCARD_ALL;
+        }
+    }
+    fmt->streams[player->video_stream_idx]->discard = AVDISCARD_DEFAULT;
+    if (player->audio_stream_idx >= 0) {
+        fmt->streams[player->audio_stream_idx]->discard = AVDISCARD_DEFAULT;
+    }
+}
+
+static void switch_variant(PrismPlayer* player, int index, PrismAbrReason reason) {
+    const AbrVariant* from = &player->abr_variants[player->abr_current];
+    const AbrVariant* to = &player->abr_variants[index];
+
+    lock_state(player);
+    player->video_stream_idx = to->video_stream;
+    if (to->audio_stream >= 0) {
+        player->audio_stream_idx = to->audio_stream;
+    }
+    apply_variant_discard(player);
+    player->abr_current = index;
+    player->abr_switches++;
+    player->abr_last_reason = reason;
+    player->abr_last_switch_time = player->current_pts;
+    double bandwidth = player->abr_bandwidth;
+    double decode_ms = player->decode_ms_avg;
+    unlock_state(player);
+
+    player->abr_segments_since_switch = 0;
+    player->abr_switch_pending = true;
+
+    prism_log(1, "ABR: variant %d -> %d (%dx%d, %lld kbps), bandwidth %.0f kbps, decode %.2f ms, %s",
+        (int)(from - player->abr_variants), index, to->width, to->height, (long long)(to->bitrate / 1000),
+        bandwidth / 1000.0, decode_ms,
+        reason == PRISM_ABR_REASON_DECODE_HEADROOM ? "decode headroom" :
+        reason == PRISM_ABR_REASON_BANDWIDTH_UP ? "bandwidth up" : "bandwidth down");
+}
+
+/* Fold each finished segment's download throughput into the bandwidth
+ * estimate and pick the variant for the next segments. A fast and a slow
+ * average are kept and the lower one used, so drops are followed quickly
+ * and short bursts are not. Steps down at once; steps up one variant at a
+ * time once a few segments confirmed the current one. */
+static void update_abr(PrismPlayer* player) {
+    const PrismThroughputMeter* meter = &player->abr_meter;
+    if (meter->closed == player->abr_seen_segments) {
+        return;
+    }
+
+    int64_t bytes = meter->bytes - player->abr_seen_bytes;
+    int64_t busy_us = meter->busy_us - player->abr_seen_us;
+    player->abr_seen_segments = meter->closed;
+    player->abr_seen_bytes = meter->bytes;
+    player->abr_seen_us = meter->busy_us;
+    player->abr_segments_since_switch++;
+    if (bytes < ABR_MIN_SAMPLE_BYTES || busy_us <= 0) {
+        return;
+    }
+
+    double sample = bytes * 8.0 * 1000000.0 / busy_us;
+    if (player->abr_fast <= 0) {
+        player->abr_fast = sample;
+        player->abr_slow = sample;
+    } else {
+        player->abr_fast += 0.5 * (sample - player->abr_fast);
+        player->abr_slow += 0.1 * (sample - player->abr_slow);
+    }
+    double bandwidth = player->abr_fast < player->abr_slow ? player->abr_fast : player->abr_slow;
+
+    lock_state(player);
+    player->abr_bandwidth = bandwidth;
+    double convert_ms = player->frames_converted > 0 ?
+        player->convert_ms_total / player->frames_converted : 0.0;
+    double load = (player->decode_ms_avg + convert_ms) / (player->frame_duration * 1000.0);
+    int max_width = player->output_max_width;
+    int max_height = player->output_max_height;
+    unlock_state(player);
+
+    /* Variants above the first one that covers the output size would only
+     * be scaled down */
+    int current = player->abr_current;
+    int target = 0;
+    for (int i = 1; i < player->abr_variant_count; i++) {
+        const AbrVariant* below = &player->abr_variants[i - 1];
+        if (max_width > 0 && max_height > 0 && below->width >= max_width && below->height >= max_height) {
+            break;
+        }
+        if (player->abr_variants[i].bitrate <= bandwidth * ABR_SAFETY) {
+            target = i;
+        }
+    }
+
+    if (load > ABR_DOWN_HEADROOM && current > 0 && target >= current) {
+        switch_variant(player, current - 1, PRISM_ABR_REASON_DECODE_HEADROOM);
+    } else if (target < current) {
+        switch_variant(player, target, PRISM_ABR_REASON_BANDWIDTH_DOWN);
+    } else if (target > current && load <= ABR_UP_HEADROOM &&
+               player->abr_segments_since_switch >= ABR_UP_SEGMENTS) {
+        switch_variant(player, current + 1, PRISM_ABR_REASON_BANDWIDTH_UP);
+    }
+}
+
+/* Bring a packet of the current variant onto the first variant's time
+ * bases. The first video packet after a switch must be a keyframe and
+ * carries the new stream's extradata, so the running decoder reconfigures
+ * instead of being reopened. Returns false to drop the packet. */
+static bool prepare_variant_packet(PrismPlayer* player, AVPacket* packet) {
+    const AVStream* stream = player->format_ctx->streams[packet->stream_index];
+    if (packet->stream_index == player->audio_stream_idx) {
+        av_packet_rescale_ts(packet, stream->time_base, player->abr_audio_time_base);
+        return true;
+    }
+    if (packet->stream_index != player->video_stream_idx) {
+        return true;
+    }
+
+    av_packet_rescale_ts(packet, stream->time_base, player->abr_video_time_base);
+    if (!player->abr_switch_pending) {
+        return true;
+    }
+    if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+        return false;
+    }
+
+    player->abr_switch_pending = false;
+    const AVCodecParameters* par = stream->codecpar;
+    if (par->extradata_size > 0) {
+        uint8_t* side_data = av_packet_new_side_data(packet, AV_PKT_DATA_NEW_EXTRADATA, par->extradata_size);
+        if (side_data) {
+            memcpy(side_data, par->extradata, par->extradata_size);
+        }
+    }
+    return true;
+}
+
+static prism_thread_ret_t PRISM_THREAD_CALL demux_thread_func(void* arg) {
+    PrismPlayer* player = (PrismPlayer*)arg;
+    AVPacket* packet = player->packet;
+    bool at_eof = false;
+
+    prism_log(1, "Demux thread started");
+
+    while (!should_stop(player)) {
+        unsigned int seq = event_seq(&player->demux_wake);
+
+        if (load_acquire(&player->index_state) == INDEX_READY) {
+            apply_keyframe_index(player);
+        }
+
+        /* Commands are applied in any state, so a paused Seek completes too */
+        if (is_stale(player, player->demux_serial)) {
+            process_commands(player);
+            at_eof = false;
+            continue;
+        }
+
+        /* Check player state. Prepare lets the pipeline run ahead while not playing. */
+        lock_state(player);
+        PrismState current_state = player->state;
+        bool prerolling = player->prerolling &&
+            (current_state == PRISM_STATE_READY || current_state == PRISM_STATE_PAUSED ||
+             current_state == PRISM_STATE_STOPPED);
+        unlock_state(player);
+
+        if ((current_state != PRISM_STATE_PLAYING && !prerolling) || at_eof) {
+            /* Sleep until Play, Prepare, a command or shutdown signals us */
+            event_wait(&player->demux_wake, seq, -1);
+            continue;
+        }
+
+        /* Read a packet */
+        int64_t read_start = av_gettime_relative();
+        int ret = av_read_frame(player->format_ctx, packet);
+
+        lock_state(player);
+        player->demux_read_us += av_gettime_relative() - read_start;
+        if (player->format_ctx->pb) {
+            player->demux_bytes = player->format_ctx->pb->bytes_read;
+        }
+        unlock_state(player);
+
+        if (ret < 0) {
+            if (ret == AVERROR_EOF) {
+                lock_state(player);
+                bool looping = player->loop && !player->is_live;
+                if (looping) {
+                    /* Loop back to start; decoders drain and flush when they reach
+                     * the marker, and the display re-syncs its clock on the first
+                     * frame of the new pass */
+                    av_seek_frame(player->format_ctx, -1, 0, AVSEEK_FLAG_BACKWARD);
+                    if (!player->video_codec_ctx) {
+                        player->current_pts = 0;
+                    }
+                }
+                unlock_state(player);
+
+                if (looping) {
+                    queue_marker(player, PACKET_FLUSH);
+                    continue;
+                }
+
+                /* Decoders finish what is queued, then report end of file.
+                 * Stay alive for a later Seek. */
+                queue_marker(player, PACKET_EOF);
+                at_eof = true;
+
+                lock_state(player);
+                if (player->prerolling) {
+                    player->prerolling = false;
+                    player->preroll_done = true;
+                }
+                unlock_state(player);
+                continue;
+            }
+            /* Other error or EAGAIN, just continue */
+            av_packet_unref(packet);
+            continue;
+        }
+
+        /* Packet time for the preroll watermark (the packet is moved when queued) */
+        double packet_time = -1.0;
+        if (prerolling && packet->pts != AV_NOPTS_VALUE) {
+            packet_time = packet->pts * av_q2d(player->format_ctx->streams[packet->stream_index]->time_base);
+        }
+
+        /* Adaptive bitrate: a finished segment may switch variants */
+        if (player->abr_variant_count > 0) {
+            update_abr(player);
+            if (!prepare_variant_packet(player, packet)) {
+                av_packet_unref(packet);
+                continue;
+            }
+        }
+
+        /* Low latency: the newest video packet is the live edge latency is measured from */
+        if (player->low_latency_active && packet->stream_index == player->video_stream_idx &&
+            packet->pts != AV_NOPTS_VALUE) {
+            double edge = packet->pts * player->video_time_base;
+            lock_state(player);
+            if (edge > player->live_edge_pts) {
+                player->live_edge_pts = edge;
+            }
+            unlock_state(player);
+        }
+
+        /* Route to the stream's decoder, waiting if its queue is full */
+        bool queued = false;
+        if (packet->stream_index == player->video_stream_idx && player->video_codec_ctx) {
+            queued = packet_queue_put_wait(player, &player->video_packets, packet, PACKET_DATA);
+        } else if (packet->stream_index == player->audio_stream_idx && player->audio_codec_ctx) {
+            queued = queue_audio_packet(player, packet, prerolling);
+        }
+
+        if (!queued) {
+            av_packet_unref(packet);
+        } else if (prerolling && packet_time >= 0) {
+            update_preroll(player, packet_time);
+        }
+    }
+
+    prism_log(1, "Demux thread stopped");
+    return (prism_thread_ret_t)0;
+}
+
+/* True if a frame covering [start, start + length) is entirely before target */
+static bool frame_ends_before(double start, double length, double target) {
+    return start + length <= target + 0.0001;
+}
+
+/* Exact seek: let the decoder skip non-reference frames that will be
+ * discarded anyway. Decided per packet in decode order, so the frame shown
+ * at the target is always decoded. */
+static void update_seek_skip(PrismPlayer* player, AVPacket* packet) {
+    if (!player->video_seek_pending) {
+        return;
+    }
+
+    bool skip = packet->pts != AV_NOPTS_VALUE &&
+        frame_ends_before(packet->pts * player->video_time_base, player->frame_duration, player->video_seek_target);
+    player->video_codec_ctx->skip_frame = skip ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+}
+
+/* Low latency: stretch or squeeze the resampler output to the live
+ * playback rate, so audio keeps pace with the video catch-up */
+static void apply_live_rate(PrismPlayer* player, const AVFrame* frame) {
+    unsigned int rate = load_acquire(&player->live_rate_permyriad);
+    if (rate == player->live_rate_applied || frame->sample_rate <= 0) {
+        return;
+    }
+
+    int out = (int)av_rescale(frame->nb_samples, player->audio_out_rate, frame->sample_rate);
+    int delta = (int)((int64_t)out * 10000 / rate) - out;
+    swr_set_compensation(player->swr_ctx, delta, delta ? out : 0);
+
+    /* Compensation only covers this frame; keep re-applying while off 1.0x */
+    player->live_rate_applied = (rate == 10000) ? rate : 0;
+}
+
+/* (Re)configure the resampler from the source format to stereo float at
+ * the output rate. swr_alloc_set_opts2 reuses an existing context, so a
+ * mid-stream format change only reinitializes it. */
+static bool configure_resampler(PrismPlayer* player, const AVChannelLayout* layout,
+    enum AVSampleFormat format, int rate) {
+    AVChannelLayout out_ch_layout = AV_CHANNEL_LAYOUT_STEREO;
+    if (swr_alloc_set_opts2(&player->swr_ctx,
+            &out_ch_layout, AV_SAMPLE_FMT_FLT, player->audio_out_rate,
+            layout, format, rate, 0, NULL) < 0) {
+        return false;
+    }
+
+    /* Low latency: rate compensation needs the resampler even at matching rates */
+    if (player->low_latency_active) {
+        av_opt_set_int(player->swr_ctx, "flags", SWR_FLAG_RESAMPLE, 0);
+    }
+    player->live_rate_applied = 10000;
+
+    av_channel_layout_uninit(&player->swr_in_layout);
+    av_channel_layout_copy(&player->swr_in_layout, layout);
+    player->swr_in_format = format;
+    player->swr_in_rate = rate;
+    return swr_init(player->swr_ctx) >= 0;
+}
+
+/* Queue a decoded video frame, waiting for a free slot rather than
+ * dropping it. Frames made stale by a Seek/Stop are dropped.
+ * Returns false if the pipeline is stopping. */
+static bool output_video_frame(PrismPlayer* player, AVFrame* frame) {
+    if (is_stale(player, player->video_serial)) {
+        return true;
+    }
+
+    /* Get frame PTS */
+    double frame_pts = 0;
+    bool has_pts = true;
+    if (frame->pts != AV_NOPTS_VALUE) {
+        frame_pts = frame->pts * player->video_time_base;
+    } else if (frame->best_effort_timestamp != AV_NOPTS_VALUE) {
+        frame_pts = frame->best_effort_timestamp * player->video_time_base;
+    } else {
+        has_pts = false;
+    }
+
+    /* Exact seek: drop frames that end before the target, unconverted. The
+     * first frame on screen at the target completes the seek. */
+    if (player->video_seek_pending) {
+        if (has_pts && frame_ends_before(frame_pts, player->frame_duration, player->video_seek_target)) {
+            return true;
+        }
+        player->video_seek_pending = false;
+        player->video_codec_ctx->skip_frame = AVDISCARD_DEFAULT;
+    }
+
+    /* Mark that we have decoded frames (clock sync happens on display) */
+    lock_state(player);
+    if (!player->first_frame_decoded) {
+        player->first_frame_decoded = true;
+        prism_log(1, "First video frame decoded, PTS: %.3f", frame_pts);
+    }
+    unlock_state(player);
+
+    /* Backpressure: wait until the display side frees a slot */
+    VideoFrameEntry* entry;
+    while (1) {
+        unsigned int seq = event_seq(&player->video_wake);
+        if ((entry = video_ring_write_slot(player)) != NULL) {
+            break;
+        }
+        if (should_stop(player)) {
+            return false;
+        }
+        if (is_stale(player, player->video_serial)) {
+            return true;
+        }
+        event_wait(&player->video_wake, seq, -1);
+    }
+
+    /* Convert into the slot (no lock: the slot is ours until committed) */
+    if (convert_video_frame(player, frame, entry->frame) >= 0) {
+        entry->pts = frame_pts;
+        entry->resync = player->video_resync_pending;
+        entry->serial = player->video_serial;
+        player->video_resync_pending = false;
+        video_ring_commit(player);
+    }
+
+    /* Update current PTS, unless a Seek moved it meanwhile */
+    lock_state(player);
+    if (!is_stale(player, player->video_serial)) {
+        player->video_pts = frame_pts;
+        player->current_pts = frame_pts;
+    }
+    unlock_state(player);
+
+    return true;
+}
+
+/* Resample a decoded audio frame into the audio ring, waiting while the
+ * ring is above its fill target. Frames made stale by a Seek/Stop are
+ * dropped. Returns false if the pipeline is stopping. */
+static bool output_audio_frame(PrismPlayer* player, AVFrame* frame) {
+    if (!player->swr_ctx || is_stale(player, player->audio_serial)) {
+        return true;
+    }
+
+    /* The audio ring's consumer may be a real-time thread that must not take
+     * locks, so it cannot signal; re-check periodically while playing */
+    while (1) {
+        unsigned int seq = event_seq(&player->audio_wake);
+        if (audio_ring_count(player) <= player->audio_fill_target) {
+            break;
+        }
+        if (should_stop(player)) {
+            return false;
+        }
+        if (is_stale(player, player->audio_serial)) {
+            return true;
+        }
+        lock_state(player);
+        bool playing = (player->state == PRISM_STATE_PLAYING);
+        unlock_state(player);
+        event_wait(&player->audio_wake, seq, playing ? 10 : -1);
+    }
+
+    /* Exact seek: drop frames that end before the target without resampling,
+     * and trim the frame that straddles it to the target sample */
+    int skip_samples = 0;
+    if (player->audio_seek_pending && frame->pts != AV_NOPTS_VALUE && frame->sample_rate > 0) {
+        double frame_pts = frame->pts * player->audio_time_base;
+        double frame_length = (double)frame->nb_samples / frame->sample_rate;
+        if (frame_ends_before(frame_pts, frame_length, player->audio_seek_target)) {
+            return true;
+        }
+        if (frame_pts < player->audio_seek_target) {
+            skip_samples = (int)((player->audio_seek_target - frame_pts) * player->audio_out_rate + 0.5);
+        }
+    }
+    player->audio_seek_pending = false;
+
+    /* Get audio PTS */
+    if (frame->pts != AV_NOPTS_VALUE) {
+        lock_state(player);
+        player->audio_pts = frame->pts * player->audio_time_base;
+        unlock_state(player);
+    }
+
+    /* Source format changed mid-stream: frames that cannot be resampled are dropped */
+    if (frame->sample_rate != player->swr_in_rate || frame->format != player->swr_in_format ||
+        av_channel_layout_compare(&frame->ch_layout, &player->swr_in_layout) != 0) {
+        prism_log(1, "Audio: source format changed to %d Hz %d ch", frame->sample_rate, frame->ch_layout.nb_channels);
+        if (!configure_resampler(player, &frame->ch_layout, (enum AVSampleFormat)frame->format, frame->sample_rate)) {
+            return true;
+        }
+    }
+
+    if (player->low_latency_active) {
+        apply_live_rate(player, frame);
+    }
+
+    /* Convert to float samples (scratch only grows for unusually large frames) */
+    int out_samples = swr_get_out_samples(player->swr_ctx, frame->nb_samples);
+    av_fast_malloc(&player->audio_scratch, &player->audio_scratch_size, out_samples * 2 * sizeof(float));
+    if (player->audio_scratch) {
+        uint8_t* out_ptr = (uint8_t*)player->audio_scratch;
+
+        int samples_converted = swr_convert(player->swr_ctx,
+            &out_ptr, out_samples,
+            (const uint8_t**)frame->data, frame->nb_samples);
+
+        if (samples_converted > skip_samples) {
+            audio_ring_write(player, player->audio_scratch + skip_samples * 2,
+                (samples_converted - skip_samples) * 2);
+        }
+    }
+
+    return true;
+}
+
+typedef bool (*FrameOutputFunc)(PrismPlayer* player, AVFrame* frame);
+
+/* Average video decode time per frame, for the ABR decode headroom */
+static void update_decode_time(PrismPlayer* player, int64_t busy_us, int frames) {
+    double frame_ms = busy_us / 1000.0 / frames;
+    lock_state(player);
+    if (player->decode_ms_avg <= 0) {
+        player->decode_ms_avg = frame_ms;
+    } else {
+        player->decode_ms_avg += 0.1 * (frame_ms - player->decode_ms_avg);
+    }
+    unlock_state(player);
+}
+
+/* Feed one packet to the decoder (NULL drains it at end of stream) and hand
+ * every frame it produces to output. If the decoder will not take the packet
+ * until its pending frames are read, those are drained first and the packet
+ * is sent again. Returns false if the pipeline is stopping. Video decode
+ * time (not counting output) is averaged per frame. */
+static bool decode_packet(PrismPlayer* player, AVCodecContext* codec_ctx, AVPacket* packet,
+    AVFrame* frame, FrameOutputFunc output, bool is_video) {
+    bool sent = false;
+    int64_t busy_us = 0;
+    int frames = 0;
+
+    while (!sent) {
+        int64_t start = av_gettime_relative();
+        int ret = avcodec_send_packet(codec_ctx, packet);
+        /* Anything but EAGAIN consumes the packet (errors skip it) */
+        sent = (ret != AVERROR(EAGAIN));
+
+        int received = 0;
+        while ((ret = avcodec_receive_frame(codec_ctx, frame)) >= 0) {
+            busy_us += av_gettime_relative() - start;
+            frames++;
+            bool keep_going = output(player, frame);
+            av_frame_unref(frame);
+            if (!keep_going) {
+                return false;
+            }
+            received++;
+            start = av_gettime_relative();
+        }
+        busy_us += av_gettime_relative() - start;
+
+        /* EAGAIN on both sides would be a decoder bug; drop the packet */
+        if (!sent && received == 0) {
+            break;
+        }
+    }
+
+    if (is_video && frames > 0) {
+        update_decode_time(player, busy_us, frames);
+    }
+    return true;
+}
+
+/* SEEK marker: drop everything buffered from before the seek and adopt its
+ * serial. The codec context stays open, so no decoder state is rebuilt. */
+static void reset_decoder(PrismPlayer* player, AVCodecContext* codec_ctx, PacketQueueEntry* entry, bool is_video) {
+    bool exact = entry->seek_target >= 0;
+
+    avcodec_flush_buffers(codec_ctx);
+    if (is_video) {
+        player->video_serial = entry->serial;
+        player->video_seek_target = entry->seek_target;
+        player->video_seek_pending = exact;
+        player->video_resync_pending = true;
+        codec_ctx->skip_frame = AVDISCARD_DEFAULT;
+    } else {
+        player->audio_serial = entry->serial;
+        player->audio_seek_target = entry->seek_target;
+        player->audio_seek_pending = exact;
+        if (player->swr_ctx) {
+            swr_init(player->swr_ctx);  /* Drop samples buffered from before the seek */
+            player->live_rate_applied = 10000;
+        }
+        audio_ring_flush(player);
+    }
+
+    lock_state(player);
+    if (is_video) {
+        player->video_eof = false;
+    } else {
+        player->audio_eof = false;
+    }
+    if (player->state == PRISM_STATE_END_OF_FILE) {
+        player->state = PRISM_STATE_PLAYING;
+    }
+    unlock_state(player);
+}
+
+/* Decode thread body shared by video and audio. FLUSH (loop) and EOF
+ * markers drain the decoder so the last frames of the stream are output;
+ * SEEK markers reset it. The thread lives until the media is closed. */
+static void run_decoder(PrismPlayer* player, PacketQueue* queue, AVCodecContext* codec_ctx,
+    AVFrame* frame, FrameOutputFunc output, bool is_video) {
+    PrismEvent* wake = queue_consumer_wake(player, queue);
+
+    while (!should_stop(player)) {
+        unsigned int seq = event_seq(wake);
+        PacketQueueEntry* entry = packet_queue_peek(queue);
+        if (!entry) {
+            event_wait(wake, seq, -1);
+            continue;
+        }
+
+        /* Queued before the newest Seek/Stop, or its marker: skip or reset */
+        if (is_stale(player, entry->serial) || entry->kind == PACKET_SEEK) {
+            if (entry->kind == PACKET_SEEK && !is_stale(player, entry->serial)) {
+                reset_decoder(player, codec_ctx, entry, is_video);
+            }
+            packet_queue_pop(queue);
+            event_signal(&player->demux_wake);
+            continue;
+        }
+
+        if (entry->kind == PACKET_DATA) {
+            if (is_video) {
+                update_seek_skip(player, entry->packet);
+            }
+            if (!decode_packet(player, codec_ctx, entry->packet, frame, output, is_video)) {
+                break;
+            }
+            packet_queue_pop(queue);
+            event_signal(&player->demux_wake);
+            continue;
+        }
+
+        if (!decode_packet(player, codec_ctx, NULL, frame, output, is_video)) {
+            break;
+        }
+
+        if (entry->kind == PACKET_EOF) {
+            /* A Seek posted while draining supersedes the end of file */
+            bool current = !is_stale(player, entry->serial);
+            packet_queue_pop(queue);
+            if (current) {
+                mark_decoder_eof(player, is_video);
+            }
+            event_signal(&player->demux_wake);
+            continue;
+        }
+
+        /* Looping: reset the drained decoder for the restarted stream */
+        avcodec_flush_buffers(codec_ctx);
+        if (is_video) {
+            player->video_resync_pending = true;
+        }
+        packet_queue_pop(queue);
+        event_signal(&player->demux_wake);
+    }
+}
+
+static prism_thread_ret_t PRISM_THREAD_CALL video_thread_func(void* arg) {
+    PrismPlayer* player = (PrismPlayer*)arg;
+
+    prism_log(1, "Video decode thread started");
+    run_decoder(player, &player->video_packets, player->video_codec_ctx,
+        player->frame, output_video_frame, true);
+    prism_log(1, "Video decode thread stopped");
+    return (prism_thread_ret_t)0;
+}
+
+static prism_thread_ret_t PRISM_THREAD_CALL audio_thread_func(void* arg) {
+    PrismPlayer* player = (PrismPlayer*)arg;
+
+    prism_log(1, "Audio decode thread started");
+    run_decoder(player, &player->audio_packets, player->audio_codec_ctx,
+        player->audio_frame, output_audio_frame, false);
+    prism_log(1, "Audio decode thread stopped");
+    return (prism_thread_ret_t)0;
+}
+
+static void start_decoder_threads(PrismPlayer* player) {
+    if (player->decoder_running) {
+        return;
+    }
+
+    store_release(&player->stop_requested, 0);
+    player->video_eof = false;
+    player->video_resync_pending = false;
+    player->audio_eof = false;
+
+    player->video_thread_started = player->video_codec_ctx &&
+        thread_create(&player->video_thread, video_thread_func, player);
+    player->audio_thread_started = player->audio_codec_ctx &&
+        thread_create(&player->audio_thread, audio_thread_func, player);
+    thread_create(&player->demux_thread, demux_thread_func, player);
+
+    player->decoder_running = true;
+    prism_log(1, "Started pipeline threads");
+}
+
+static void stop_decoder_threads(PrismPlayer* player) {
+    if (!player->decoder_running) {
+        return;
+    }
+
+    store_release(&player->stop_requested, 1);
+    wake_pipeline(player);
+
+    thread_join(&player->demux_thread);
+    if (player->video_thread_started) {
+        thread_join(&player->video_thread);
+        player->video_thread_started = false;
+    }
+    if (player->audio_thread_started) {
+        thread_join(&player->audio_thread);
+        player->audio_thread_started = false;
+    }
+
+    player->decoder_running = false;
+    prism_log(1, "Stopped pipeline threads");
+}
+
+/* ============================================================================
+ * Keyframe Index
+ * ========================================================================== */
+
+static int index_interrupt(void* opaque) {
+    PrismPlayer* player = (PrismPlayer*)opaque;
+    return load_acquire(&player->index_cancel) != 0;
+}
+
+/* Keep the index scan from competing with playback. Elsewhere the thread
+ * keeps the default priority. */
+static void lower_thread_priority(void) {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(SCHED_IDLE)
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+static prism_thread_ret_t PRISM_THREAD_CALL index_thread_func(void* arg) {
+    PrismPlayer* player = (PrismPlayer*)arg;
+    AVIOInterruptCB interrupt = { index_interrupt, player };
+
+    lower_thread_priority();
+
+    int64_t start = av_gettime();
+    int ret = prism_index_build(&player->keyframe_index, player->index_url,
+        player->keyframe_index.stream_index, &interrupt);
+
+    if (ret < 0 || player->keyframe_index.count == 0) {
+        if (!load_acquire(&player->index_cancel)) {
+            prism_log(1, "Keyframe index: build failed (%d)", ret);
+        }
+        store_release(&player->index_state, INDEX_NONE);
+        return (prism_thread_ret_t)0;
+    }
+
+    prism_log(1, "Keyframe index: %d keyframes in %.1f ms",
+        player->keyframe_index.count, (av_gettime() - start) / 1000.0);
+
+    if (player->index_cache_path[0] && !prism_index_save(&player->keyframe_index, player->index_cache_path)) {
+        prism_log(1, "Keyframe index: could not write %s", player->index_cache_path);
+    }
+
+    store_release(&player->index_state, INDEX_READY);
+    event_signal(&player->demux_wake);
+    return (prism_thread_ret_t)0;
+}
+
+/* Called from Open before the pipeline starts. Uses the cached index for
+ * this file if there is one, otherwise starts building it in the background.
+ * Skipped when the container's own index already covers the stream. */
+static void setup_keyframe_index(PrismPlayer* player, const char* url) {
+    int stream_index = (player->video_stream_idx >= 0) ? player->video_stream_idx : player->audio_stream_idx;
+    if (!player->keyframe_index_enabled || player->is_live || stream_index < 0 || !player->format_ctx->pb) {
+        return;
+    }
+
+    /* Scanning a remote file would download all of it */
+    const char* protocol = avio_find_protocol_name(url);
+    if (!protocol || strcmp(protocol, "file") != 0) {
+        return;
+    }
+
+    AVStream* stream = player->format_ctx->streams[stream_index];
+    if (prism_index_stream_is_indexed(stream, player->format_ctx->duration)) {
+        prism_log(1, "Keyframe index: container index is complete");
+        return;
+    }
+
+    uint64_t key = prism_index_file_key(url, avio_size(player->format_ctx->pb));
+    player->keyframe_index.key = key;
+    player->keyframe_index.stream_index = stream_index;
+
+    if (g_index_cache_dir[0]) {
+        prism_index_cache_path(player->index_cache_path, sizeof(player->index_cache_path), g_index_cache_dir, key);
+        if (prism_index_load(&player->keyframe_index, player->index_cache_path, key)) {
+            /* Pipeline threads are not running yet, so merge it right away */
+            player->index_keyframes = prism_index_apply(&player->keyframe_index, player->format_ctx);
+            store_release(&player->index_state, INDEX_APPLIED);
+            prism_log(1, "Keyframe index: %d keyframes from cache", player->index_keyframes);
+            return;
+        }
+    }
+
+    player->index_url = av_strdup(url);
+    store_release(&player->index_cancel, 0);
+    store_release(&player->index_state, INDEX_BUILDING);
+    player->index_thread_started = player->index_url &&
+        thread_create(&player->index_thread, index_thread_func, player);
+    if (!player->index_thread_started) {
+        store_release(&player->index_state, INDEX_NONE);
+    }
+}
+
+/* Cancel an index build and release the index. Called from Close. */
+static void release_keyframe_index(PrismPlayer* player) {
+    store_release(&player->index_cancel, 1);
+    if (player->index_thread_started) {
+        thread_join(&player->index_thread);
+        player->index_thread_started = false;
+    }
+
+    prism_index_free(&player->keyframe_index);
+    av_freep(&player->index_url);
+    player->index_cache_path[0] = '\0';
+    player->index_keyframes = 0;
+    store_release(&player->index_state, INDEX_NONE);
+}
+
+/* ============================================================================
+ * Stream Info Cache
+ *
+ * Codec parameters from a probed Open, keyed by URL (the playlist for HLS),
+ * so reopening the same source can skip avformat_find_stream_info.
+ * ========================================================================== */
+
+static void lock_stream_info(void) {
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&g_stream_info_lock);
+#else
+    pthread_mutex_lock(&g_stream_info_lock);
+#endif
+}
+
+static void unlock_stream_info(void) {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(&g_stream_info_lock);
+#else
+    pthread_mutex_unlock(&g_stream_info_lock);
+#endif
+}
+
+static void stream_info_entry_free(StreamInfoEntry* entry) {
+    for (unsigned int i = 0; entry->params && i < entry->nb_streams; i++) {
+        avcodec_parameters_free(&entry->params[i]);
+    }
+    av_freep(&entry->params);
+    av_freep(&entry->frame_rates);
+    av_freep(&entry->url);
+    entry->nb_streams = 0;
+}
+
+static StreamInfoEntry* stream_info_find(const char* url) {
+    for (int i = 0; i < STREAM_INFO_CACHE_SIZE; i++) {
+        if (g_stream_info_cache[i].url && strcmp(g_stream_info_cache[i].url, url) == 0) {
+            return &g_stream_info_cache[i];
+        }
+    }
+    return NULL;
+}
+
+/* Remember a probed context's stream parameters, replacing the least
+ * recently used entry when the cache is full */
+static void stream_info_cache_store(const char* url, AVFormatContext* ctx) {
+    lock_stream_info();
+
+    StreamInfoEntry* entry = stream_info_find(url);
+    if (!entry) {
+        entry = &g_stream_info_cache[0];
+        for (int i = 1; i < STREAM_INFO_CACHE_SIZE && entry->url; i++) {
+            if (!g_stream_info_cache[i].url || g_stream_info_cache[i].last_used < entry->last_used) {
+                entry = &g_stream_info_cache[i];
+            }
+        }
+    }
+    stream_info_entry_free(entry);
+
+    entry->url = av_strdup(url);
+    entry->params = (AVCodecParameters**)av_calloc(ctx->nb_streams, sizeof(AVCodecParameters*));
+    entry->frame_rates = (AVRational*)av_calloc(ctx->nb_streams, sizeof(AVRational));
+    bool ok = entry->url && entry->params && entry->frame_rates;
+    for (unsigned int i = 0; ok && i < ctx->nb_streams; i++) {
+        entry->params[i] = avcodec_parameters_alloc();
+        ok = entry->params[i] && avcodec_parameters_copy(entry->params[i], ctx->streams[i]->codecpar) >= 0;
+        entry->frame_rates[i] = ctx->streams[i]->avg_frame_rate;
+        entry->nb_streams = i + 1;
+    }
+    entry->duration = ctx->duration;
+    entry->last_used = av_gettime_relative();
+    if (!ok) {
+        stream_info_entry_free(entry);
+    }
+
+    unlock_stream_info();
+}
+
+/* Seed a freshly opened context from the cache. Only used when the demuxer
+ * reports the same streams and codecs as when the entry was stored. */
+static bool stream_info_cache_apply(const char* url, AVFormatContext* ctx) {
+    lock_stream_info();
+
+    StreamInfoEntry* entry = stream_info_find(url);
+    bool match = entry && entry->nb_streams == ctx->nb_streams && ctx->nb_streams > 0;
+    for (unsigned int i = 0; match && i < ctx->nb_streams; i++) {
+        const AVCodecParameters* par = ctx->streams[i]->codecpar;
+        match = par->codec_type == entry->params[i]->codec_type &&
+            (par->codec_id == entry->params[i]->codec_id || par->codec_id == AV_CODEC_ID_NONE);
+    }
+    for (unsigned int i = 0; match && i < ctx->nb_streams; i++) {
+        match = avcodec_parameters_copy(ctx->streams[i]->codecpar, entry->params[i]) >= 0;
+        if (ctx->streams[i]->avg_frame_rate.num == 0) {
+            ctx->streams[i]->avg_frame_rate = entry->frame_rates[i];
+        }
+    }
+    if (match) {
+        if (ctx->duration == AV_NOPTS_VALUE) {
+            ctx->duration = entry->duration;
+        }
+        entry->last_used = av_gettime_relative();
+    }
+
+    unlock_stream_info();
+    return match;
+}
+
+static void stream_info_cache_clear(void) {
+    lock_stream_info();
+    for (int i = 0; i < STREAM_INFO_CACHE_SIZE; i++) {
+        stream_info_entry_free(&g_stream_info_cache[i]);
+    }
+    unlock_stream_info();
+}
+
+/* Fast open: codecs whose parameters MP4 and Matroska headers carry in full
+ * (sizes, rates, extradata), so probing would only re-derive them. The
+ * pixel format may still be unknown; conversion is then set up on the
+ * first frame. */
+static bool header_describes_stream(const AVCodecParameters* par) {
+    switch (par->codec_id) {
+        case AV_CODEC_ID_H264:
+        case AV_CODEC_ID_HEVC:
+            return par->width > 0 && par->height > 0 && par->extradata_size > 0;
+        case AV_CODEC_ID_VP8:
+        case AV_CODEC_ID_VP9:
+        case AV_CODEC_ID_AV1:
+            return par->width > 0 && par->height > 0;
+        case AV_CODEC_ID_AAC:
+        case AV_CODEC_ID_OPUS:
+        case AV_CODEC_ID_VORBIS:
+        case AV_CODEC_ID_MP3:
+            return par->sample_rate > 0 && par->ch_layout.nb_channels > 0;
+        default:
+            return false;
+    }
+}
+
+/* True if the first video and audio streams (the ones Open decodes) are
+ * fully described by the container header */
+static bool header_describes_streams(AVFormatContext* ctx) {
+    const char* name = ctx->iformat ? ctx->iformat->name : "";
+    if (!strstr(name, "mov") && !strstr(name, "matroska")) {
+        return false;
+    }
+
+    bool video_seen = false;
+    bool audio_seen = false;
+    for (unsigned int i = 0; i < ctx->nb_streams; i++) {
+        const AVCodecParameters* par = ctx->streams[i]->codecpar;
+        bool* seen = (par->codec_type == AVMEDIA_TYPE_VIDEO) ? &video_seen :
+            (par->codec_type == AVMEDIA_TYPE_AUDIO) ? &audio_seen : NULL;
+        if (!seen || *seen) {
+            continue;
+        }
+        if (!header_describes_stream(par)) {
+            return false;
+        }
+        *seen = true;
+    }
+    return video_seen || audio_seen;
+}
+
+/* Queue a Seek/Stop for the demux thread. Bumping serial makes everything
+ * already in flight stale at once; buffered audio is cut immediately too.
+ * Called with state_lock held; the caller wakes the pipeline afterwards. */
+static void post_command(PrismPlayer* player, CommandType type, double position, PrismSeekMode mode) {
+    /* Only the newest command is carried out, so a full queue just replaces it */
+    if (player->command_count == COMMAND_QUEUE_SIZE) {
+        player->command_count--;
+    }
+
+    PrismCommand* command = &player->commands[player->command_count++];
+    command->type = type;
+    command->position = position;
+    command->mode = mode;
+    command->serial = atomic_add(&player->serial, 1);
+
+    if (player->audio_buffer) {
+        audio_ring_flush(player);
+    }
+}
+
+/* ============================================================================
+ * Initialization
+ * ========================================================================== */
+
+PRISM_API int prism_init(void) {
+    if (g_initialized) {
+        return PRISM_OK;
+    }
+
+    /* FFmpeg 4.0+ doesn't require av_register_all() */
+    avformat_network_init();
+
+    if (g_core_budget <= 0) {
+        g_core_budget = av_cpu_count();
+    }
+
+    g_initialized = true;
+    prism_log(1, "Prism FFmpeg initialized. FFmpeg version: %s, core budget: %d",
+        av_version_info(), g_core_budget);
+
+    return PRISM_OK;
+}
+
+PRISM_API void prism_shutdown(void) {
+    if (!g_initialized) {
+        return;
+    }
+
+    stream_info_cache_clear();
+    prism_frame_pool_clear();
     avformat_network_deinit();
     g_initialized = false;
     prism_log(1, "Prism FFmpeg shutdown");
 }
 
-PRISM_API const char* prism_get_ffmpeg_version(void) {
-    return av_version_info();
+PRISM_API const char* prism_get_ffmpeg_version(void) {
+    return av_version_info();
+}
+
+PRISM_API const char* prism_get_version(void) {
+    return PRISM_VERSION;
+}
+
+PRISM_API void prism_set_log_callback(PrismLogCallback callback) {
+    g_log_callback = callback;
+}
+
+PRISM_API void prism_set_core_budget(int cores) {
+    g_core_budget = (cores > 0) ? cores : av_cpu_count();
+    prism_log(1, "Core budget set to %d", g_core_budget);
+}
+
+PRISM_API int prism_get_core_budget(void) {
+    return g_core_budget > 0 ? g_core_budget : av_cpu_count();
+}
+
+PRISM_API void prism_set_media_cache(const char* path, int64_t max_bytes) {
+    prism_cache_configure(path, max_bytes);
+    if (path && max_bytes > 0) {
+        prism_log(1, "Media cache: %s (%lld MB)", path, (long long)(max_bytes / (1024 * 1024)));
+    } else {
+        prism_log(1, "Media cache: disabled");
+    }
 }
 
-PRISM_API const char* prism_get_version(void) {
-    return PRISM_VERSION;
+PRISM_API void prism_set_huge_pages(bool enabled) {
+    prism_frame_pool_set_huge_pages(enabled);
+    prism_log(1, "Huge page frame buffers: %s", enabled ? "enabled" : "disabled");
 }
 
-PRISM_API void prism_set_log_callback(PrismLogCallback callback) {
-    g_log_callback = callback;
+PRISM_API void prism_set_index_cache_dir(const char* path) {
+    if (path) {
+        snprintf(g_index_cache_dir, sizeof(g_index_cache_dir), "%s", path);
+    } else {
+        g_index_cache_dir[0] = '\0';
+    }
+    prism_log(1, "Keyframe index cache: %s", g_index_cache_dir[0] ? g_index_cache_dir : "disabled");
 }
 
 /* ============================================================================
@@ -526,26 +2540,48 @@ PRISM_API PrismPlayer* prism_player_create(void) {
     player->speed = 1.0f;
     player->volume = 1.0f;
     player->use_hw_accel = false;
+    player->decode_thread_mode = PRISM_THREAD_MODE_AUTO;
+    player->open_profile = PRISM_OPEN_PROFILE_DEFAULT;
+    player->target_latency = LIVE_DEFAULT_LATENCY;
+    player->live_rate = 1.0;
+    player->decode_thread_count = 0;
+    player->convert_thread_count = 0;
     player->decoder_running = false;
+    player->demux_seek_target = -1.0;
+    player->keyframe_index_enabled = true;
+    player->read_ahead_size = PRISM_READ_AHEAD_DEFAULT_SIZE;
+    player->abr_enabled = true;
+    player->preroll_seconds = 0.5;
     player->output_sample_rate = 48000;  /* Default, should be set from Unity before Open() */
 
     /* Initialize locks */
 #ifdef _WIN32
     InitializeCriticalSection(&player->state_lock);
-    InitializeCriticalSection(&player->queue_lock);
 #else
     pthread_mutex_init(&player->state_lock, NULL);
-    pthread_mutex_init(&player->queue_lock, NULL);
 #endif
+    event_init(&player->demux_wake);
+    event_init(&player->video_wake);
+    event_init(&player->audio_wake);
+    event_init(&player->convert_wake);
+    event_init(&player->convert_done);
+    player->convert_bands = 1;
 
     /* Initialize video queue */
+    bool frames_ok = true;
     for (int i = 0; i < VIDEO_QUEUE_SIZE; i++) {
-        player->video_queue[i].data = NULL;
-        player->video_queue[i].valid = false;
+        player->video_queue[i].frame = av_frame_alloc();
+        frames_ok = frames_ok && player->video_queue[i].frame;
+    }
+    player->display_frame = av_frame_alloc();
+    frames_ok = frames_ok &&
+        packet_queue_init(&player->video_packets, VIDEO_PACKET_QUEUE_SIZE) &&
+        packet_queue_init(&player->audio_packets, AUDIO_PACKET_QUEUE_SIZE);
+    if (!frames_ok || !player->display_frame) {
+        prism_player_destroy(player);
+        return NULL;
     }
-    player->video_queue_write = 0;
-    player->video_queue_read = 0;
-    player->video_queue_count = 0;
+    video_ring_reset(player);
 
     prism_log(1, "Player created");
     return player;
@@ -556,28 +2592,25 @@ PRISM_API void prism_player_destroy(PrismPlayer* player) {
         return;
     }
 
+    /* Also releases queued and displayed frame buffers */
     prism_player_close(player);
 
-    /* Free video queue buffers */
     for (int i = 0; i < VIDEO_QUEUE_SIZE; i++) {
-        if (player->video_queue[i].data) {
-            av_free(player->video_queue[i].data);
-            player->video_queue[i].data = NULL;
-        }
-    }
-
-    /* Free display buffer */
-    if (player->display_buffer) {
-        av_free(player->display_buffer);
-        player->display_buffer = NULL;
+        av_frame_free(&player->video_queue[i].frame);
     }
-
+    av_frame_free(&player->display_frame);
+    packet_queue_free(&player->video_packets);
+    packet_queue_free(&player->audio_packets);
+
+    event_destroy(&player->demux_wake);
+    event_destroy(&player->video_wake);
+    event_destroy(&player->audio_wake);
+    event_destroy(&player->convert_wake);
+    event_destroy(&player->convert_done);
 #ifdef _WIN32
     DeleteCriticalSection(&player->state_lock);
-    DeleteCriticalSection(&player->queue_lock);
 #else
     pthread_mutex_destroy(&player->state_lock);
-    pthread_mutex_destroy(&player->queue_lock);
 #endif
 
     free(player);
@@ -592,17 +2625,189 @@ PRISM_API int prism_player_open(PrismPlayer* player, const char* url) {
     return prism_player_open_with_options(player, url, NULL);
 }
 
+/* Progressive HTTP sources read through the read-ahead ring. HLS and DASH
+ * fetch their segments through nested contexts the ring cannot cover. */
+static bool use_read_ahead(PrismPlayer* player, const char* url) {
+    if (player->read_ahead_size == 0) {
+        return false;
+    }
+    if (strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0) {
+        return false;
+    }
+    return !strstr(url, "m3u8") && !strstr(url, ".mpd");
+}
+
+/* Local files (plain paths or file: URLs). Playlists open their segments
+ * through nested contexts, so they keep FFmpeg's file protocol. */
+static bool use_mapped_file(PrismPlayer* player, const char* url) {
+    if (player->file_backend != PRISM_FILE_BACKEND_MMAP || strstr(url, "m3u8")) {
+        return false;
+    }
+    return strncmp(url, "file:", 5) == 0 || !strstr(url, "://");
+}
+
+/* Segmented streams: media segments opened by the demuxer go through the
+ * media cache, and through the ABR throughput meter. Playlists may be live
+ * and are always fetched. */
+static int segment_io_open(AVFormatContext* s, AVIOContext** pb, const char* url, int flags,
+    AVDictionary** options) {
+    PrismPlayer* player = (PrismPlayer*)s->opaque;
+    if ((flags & AVIO_FLAG_WRITE) || !s->pb || strstr(url, "m3u8") || strstr(url, ".mpd")) {
+        return player->default_io_open(s, pb, url, flags, options);
+    }
+
+    int ret;
+    if (prism_cache_accepts(url)) {
+        if (options && s->protocol_whitelist) {
+            av_dict_set(options, "protocol_whitelist", s->protocol_whitelist, 0);
+        }
+        ret = prism_cache_open(pb, url, &s->interrupt_callback, options);
+    } else {
+        ret = player->default_io_open(s, pb, url, flags, options);
+    }
+
+    /* An unmetered segment still plays; it just does not count */
+    if (ret >= 0 && player->abr_metering) {
+        prism_meter_wrap(pb, &player->abr_meter);
+    }
+    return ret;
+}
+
+static int segment_io_close(AVFormatContext* s, AVIOContext* pb) {
+    PrismPlayer* player = (PrismPlayer*)s->opaque;
+    if (prism_meter_is_wrapper(pb)) {
+        pb = prism_meter_unwrap(pb);
+    }
+    if (prism_cache_is_cached_context(pb)) {
+        prism_cache_close(&pb);
+        return 0;
+    }
+    return player->default_io_close2(s, pb);
+}
+
+/* Close the demuxer and the custom I/O under it (state_lock held) */
+static void close_input(PrismPlayer* player) {
+    avformat_close_input(&player->format_ctx);
+    prism_read_ahead_close(&player->read_ahead);
+    prism_mapped_file_close(&player->mapped_file);
+    prism_cache_close(&player->cached_input);
+}
+
+/* Advertised bitrate of a variant's stream (HLS/DASH set variant_bitrate) */
+static int64_t variant_bitrate(const AVStream* stream) {
+    const AVDictionaryEntry* entry = av_dict_get(stream->metadata, "variant_bitrate", NULL, 0);
+    int64_t bitrate = entry ? strtoll(entry->value, NULL, 10) : 0;
+    return bitrate > 0 ? bitrate : stream->codecpar->bit_rate;
+}
+
+/* Audio stream that plays with a variant's video: the audio of its program,
+ * or -1 to keep the current audio (separate renditions, no programs).
+ * Returns -2 if the program's audio cannot feed the open audio decoder. */
+static int variant_audio_stream(AVFormatContext* fmt, int video_stream, const AVCodecParameters* audio) {
+    AVProgram* program = av_find_program_from_stream(fmt, NULL, video_stream);
+    if (!program) {
+        return -1;
+    }
+
+    int found = -1;
+    for (unsigned int i = 0; i < program->nb_stream_indexes; i++) {
+        const AVCodecParameters* par = fmt->streams[program->stream_index[i]]->codecpar;
+        if (par->codec_type != AVMEDIA_TYPE_AUDIO) {
+            continue;
+        }
+        if (audio && par->codec_id == audio->codec_id && par->sample_rate == audio->sample_rate &&
+            par->ch_layout.nb_channels == audio->ch_layout.nb_channels) {
+            return (int)program->stream_index[i];
+        }
+        found = -2;
+    }
+    return audio ? found : -1;
+}
+
+/* Adaptive bitrate: collect the video streams of a segmented source that
+ * the open decoders can switch between (same video codec, audio in the same
+ * format), ordered by bitrate, and start on the lowest. (state_lock held) */
+static void setup_abr_variants(PrismPlayer* player) {
+    AVFormatContext* fmt = player->format_ctx;
+    player->abr_variant_count = 0;
+    if (!player->abr_metering || player->video_stream_idx < 0) {
+        return;
+    }
+
+    const AVCodecParameters* video = fmt->streams[player->video_stream_idx]->codecpar;
+    const AVCodecParameters* audio = player->audio_stream_idx >= 0 ?
+        fmt->streams[player->audio_stream_idx]->codecpar : NULL;
+    AbrVariant* variants = player->abr_variants;
+    int count = 0;
+
+    for (unsigned int i = 0; i < fmt->nb_streams && count < ABR_MAX_VARIANTS; i++) {
+        const AVStream* stream = fmt->streams[i];
+        if (stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO ||
+            stream->codecpar->codec_id != video->codec_id ||
+            (stream->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+            continue;
+        }
+        int64_t bitrate = variant_bitrate(stream);
+        int audio_stream = variant_audio_stream(fmt, (int)i, audio);
+        if (bitrate <= 0 || audio_stream == -2) {
+            continue;
+        }
+
+        /* Insert ordered by bitrate */
+        int pos = count++;
+        while (pos > 0 && variants[pos - 1].bitrate > bitrate) {
+            variants[pos] = variants[pos - 1];
+            pos--;
+        }
+        variants[pos].video_stream = (int)i;
+        variants[pos].audio_stream = audio_stream;
+        variants[pos].bitrate = bitrate;
+        variants[pos].width = stream->codecpar->width;
+        variants[pos].height = stream->codecpar->height;
+    }
+
+    if (count < 2) {
+        return;
+    }
+
+    player->abr_variant_count = count;
+    player->abr_current = 0;
+    player->video_stream_idx = variants[0].video_stream;
+    if (variants[0].audio_stream >= 0) {
+        player->audio_stream_idx = variants[0].audio_stream;
+    }
+    apply_variant_discard(player);
+
+    player->abr_video_time_base = fmt->streams[player->video_stream_idx]->time_base;
+    if (player->audio_stream_idx >= 0) {
+        player->abr_audio_time_base = fmt->streams[player->audio_stream_idx]->time_base;
+    }
+
+    for (int i = 0; i < count; i++) {
+        prism_log(1, "ABR: variant %d: %dx%d, %lld kbps", i, variants[i].width, variants[i].height,
+            (long long)(variants[i].bitrate / 1000));
+    }
+}
+
 PRISM_API int prism_player_open_with_options(PrismPlayer* player, const char* url, const char* options) {
     if (!player || !url) {
         return PRISM_ERROR_INVALID_PARAMETER;
     }
 
-    /* Close any existing media (this also stops decoder thread) */
+    /* Close any existing media (this also stops the pipeline threads) */
     prism_player_close(player);
 
-    lock_state(player);
+    /* Share the core budget with the other open players from here until Close */
+    atomic_add(&g_player_count, 1);
+    player->counted = true;
+
+    int64_t open_start = av_gettime_relative();
 
+    lock_state(player);
     player->state = PRISM_STATE_OPENING;
+    bool fast_open = (player->open_profile == PRISM_OPEN_PROFILE_FAST);
+    unlock_state(player);
+
     prism_log(1, "Opening: %s", url);
 
     /* Set up format context with options */
@@ -618,32 +2823,138 @@ PRISM_API int prism_player_open_with_options(PrismPlayer* player, const char* ur
         av_dict_set(&format_opts, "protocol_whitelist", "file,http,https,tcp,tls,crypto", 0);
     }
 
+    /* Low latency: hand packets out as they arrive instead of buffering
+     * them while the demuxer probes */
+    if (player->low_latency) {
+        av_dict_set(&format_opts, "fflags", "+nobuffer", 0);
+    }
+
+    /* Fast open: probe 128 KB / 0.5 s instead of FFmpeg's 5 MB / 5 s */
+    if (fast_open) {
+        av_dict_set(&format_opts, "probesize", "131072", 0);
+        av_dict_set(&format_opts, "analyzeduration", "500000", 0);
+    }
+
     /* Parse custom options if provided */
     if (options && strlen(options) > 0) {
         av_dict_parse_string(&format_opts, options, "=", ",", 0);
     }
 
-    /* Open input */
-    int ret = avformat_open_input(&player->format_ctx, url, NULL, &format_opts);
+    /* Open input. Network I/O happens here and in stream info probing, so
+     * neither holds state_lock: the host thread can keep polling. */
+    AVFormatContext* format_ctx = NULL;
+    PrismReadAhead* read_ahead = NULL;
+    PrismMappedFile* mapped_file = NULL;
+    AVIOContext* cached_input = NULL;
+    AVIOContext* custom_io = NULL;
+    bool segmented = strstr(url, "m3u8") || strstr(url, ".mpd");
+    int ret = 0;
+
+    /* Stopping the pipeline also aborts blocking reads from here on */
+    store_release(&player->stop_requested, 0);
+    AVIOInterruptCB interrupt = { demux_interrupt, player };
+
+    /* Segments read while probing count towards the first estimate too */
+    player->abr_metering = segmented && player->abr_enabled;
+    memset(&player->abr_meter, 0, sizeof(player->abr_meter));
+    player->abr_seen_bytes = 0;
+    player->abr_seen_us = 0;
+    player->abr_seen_segments = 0;
+    player->abr_segments_since_switch = 0;
+    player->abr_fast = 0;
+    player->abr_slow = 0;
+    player->abr_switch_pending = false;
+    if (use_read_ahead(player, url)) {
+        /* Takes the protocol options; the rest go to the demuxer. Reads
+         * through the media cache when it is enabled. */
+        ret = prism_read_ahead_open(&read_ahead, url, player->read_ahead_size, &format_opts);
+        if (ret >= 0) {
+            custom_io = prism_read_ahead_context(read_ahead);
+        }
+    } else if (!segmented && prism_cache_accepts(url)) {
+        ret = prism_cache_open(&cached_input, url, &interrupt, &format_opts);
+        custom_io = cached_input;
+    } else if (use_mapped_file(player, url)) {
+        if (prism_mapped_file_open(&mapped_file, url) >= 0) {
+            custom_io = prism_mapped_file_context(mapped_file);
+        } else {
+            prism_log(1, "File could not be mapped, using the file protocol");
+        }
+    }
+    if (custom_io) {
+        if ((format_ctx = avformat_alloc_context()) != NULL) {
+            format_ctx->pb = custom_io;
+            format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        } else {
+            ret = AVERROR(ENOMEM);
+        }
+    } else if (segmented && (prism_cache_accepts(url) || player->abr_metering) && ret >= 0) {
+        /* Segments are cached and metered through the demuxer's nested I/O.
+         * Persistent HTTP reuses FFmpeg's own connection for the next
+         * segment, which a cached or metered context does not have. */
+        if ((format_ctx = avformat_alloc_context()) != NULL) {
+            player->default_io_open = format_ctx->io_open;
+            player->default_io_close2 = format_ctx->io_close2;
+            format_ctx->opaque = player;
+            format_ctx->io_open = segment_io_open;
+            format_ctx->io_close2 = segment_io_close;
+            av_dict_set(&format_opts, "http_persistent", "0", 0);
+        } else {
+            ret = AVERROR(ENOMEM);
+        }
+    }
+    if (ret >= 0 && !format_ctx && (format_ctx = avformat_alloc_context()) == NULL) {
+        ret = AVERROR(ENOMEM);
+    }
+    if (ret >= 0) {
+        format_ctx->interrupt_callback = interrupt;
+        ret = avformat_open_input(&format_ctx, url, NULL, &format_opts);
+    }
     av_dict_free(&format_opts);
 
     if (ret < 0) {
+        prism_read_ahead_close(&read_ahead);
+        prism_mapped_file_close(&mapped_file);
+        prism_cache_close(&cached_input);
         char errbuf[256];
         av_strerror(ret, errbuf, sizeof(errbuf));
+        lock_state(player);
         set_error(player, PRISM_ERROR_OPEN_FAILED, errbuf);
         unlock_state(player);
         return PRISM_ERROR_OPEN_FAILED;
     }
 
-    /* Find stream info */
-    ret = avformat_find_stream_info(player->format_ctx, NULL);
-    if (ret < 0) {
-        set_error(player, PRISM_ERROR_OPEN_FAILED, "Could not find stream info");
-        avformat_close_input(&player->format_ctx);
-        unlock_state(player);
-        return PRISM_ERROR_OPEN_FAILED;
+    /* Find stream info, unless the fast profile already knows it */
+    bool open_warm = fast_open &&
+        (header_describes_streams(format_ctx) || stream_info_cache_apply(url, format_ctx));
+    double probe_ms = 0.0;
+    if (!open_warm) {
+        int64_t probe_start = av_gettime_relative();
+        ret = avformat_find_stream_info(format_ctx, NULL);
+        probe_ms = (av_gettime_relative() - probe_start) / 1000.0;
+        if (ret < 0) {
+            avformat_close_input(&format_ctx);
+            prism_read_ahead_close(&read_ahead);
+            prism_mapped_file_close(&mapped_file);
+            prism_cache_close(&cached_input);
+            lock_state(player);
+            set_error(player, PRISM_ERROR_OPEN_FAILED, "Could not find stream info");
+            unlock_state(player);
+            return PRISM_ERROR_OPEN_FAILED;
+        }
+        if (fast_open) {
+            stream_info_cache_store(url, format_ctx);
+        }
     }
 
+    lock_state(player);
+    player->format_ctx = format_ctx;
+    player->read_ahead = read_ahead;
+    player->mapped_file = mapped_file;
+    player->cached_input = cached_input;
+    player->demux_read_us = 0;
+    player->demux_bytes = 0;
+
     /* Detect if live stream - check multiple indicators */
     bool duration_unknown = (player->format_ctx->duration == AV_NOPTS_VALUE);
     bool is_hls = (strstr(url, ".m3u8") != NULL) || (strstr(url, "m3u8") != NULL);
@@ -656,6 +2967,14 @@ PRISM_API int prism_player_open_with_options(PrismPlayer* player, const char* ur
     prism_log(1, "Live detection: duration_unknown=%d, is_hls=%d, is_rtsp=%d, is_rtmp=%d -> is_live=%d",
         duration_unknown, is_hls, is_rtsp, is_rtmp, player->is_live);
 
+    player->low_latency_active = player->low_latency && player->is_live;
+    player->live_edge_pts = 0.0;
+    player->live_latency = 0.0;
+    player->live_rate = 1.0;
+    store_release(&player->live_rate_permyriad, 10000);
+    player->live_rate_applied = 10000;
+    player->live_frames_dropped = 0;
+
     /* Find video stream */
     for (unsigned int i = 0; i < player->format_ctx->nb_streams; i++) {
         if (player->format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
@@ -672,9 +2991,16 @@ PRISM_API int prism_player_open_with_options(PrismPlayer* player, const char* ur
         }
     }
 
+    player->abr_bandwidth = 0;
+    player->abr_switches = 0;
+    player->abr_last_reason = PRISM_ABR_REASON_NONE;
+    player->abr_last_switch_time = 0;
+    player->decode_ms_avg = 0;
+    setup_abr_variants(player);
+
     if (player->video_stream_idx < 0 && player->audio_stream_idx < 0) {
         set_error(player, PRISM_ERROR_NO_VIDEO_STREAM, "No video or audio streams found");
-        avformat_close_input(&player->format_ctx);
+        close_input(player);
         unlock_state(player);
         return PRISM_ERROR_NO_VIDEO_STREAM;
     }
@@ -686,7 +3012,7 @@ PRISM_API int prism_player_open_with_options(PrismPlayer* player, const char* ur
 
         if (!codec) {
             set_error(player, PRISM_ERROR_CODEC_NOT_FOUND, "Video codec not found");
-            avformat_close_input(&player->format_ctx);
+            close_input(player);
             unlock_state(player);
             return PRISM_ERROR_CODEC_NOT_FOUND;
         }
@@ -699,16 +3025,56 @@ PRISM_API int prism_player_open_with_options(PrismPlayer* player, const char* ur
             /* TODO: Implement hardware acceleration */
         }
 
+        configure_decode_threads(player, player->video_codec_ctx, codec);
+        if (player->low_latency_active) {
+            player->video_codec_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        }
+
+        /* Lowres: decode at the largest 1/2^n size still covering the output */
+        if (player->lowres_enabled && codec->max_lowres > 0) {
+            int src_width = video_stream->codecpar->width;
+            int src_height = video_stream->codecpar->height;
+            int out_width = src_width;
+            int out_height = src_height;
+            fit_output_size(player->output_max_width, player->output_max_height, &out_width, &out_height);
+
+            int lowres = 0;
+            while (lowres < codec->max_lowres &&
+                   (src_width >> (lowres + 1)) >= out_width && (src_height >> (lowres + 1)) >= out_height) {
+                lowres++;
+            }
+            if (lowres > 0) {
+                player->video_codec_ctx->lowres = lowres;
+                prism_log(1, "Video: decoding at 1/%d size (lowres %d)", 1 << lowres, lowres);
+            }
+        }
+
         ret = avcodec_open2(player->video_codec_ctx, codec, NULL);
         if (ret < 0) {
             set_error(player, PRISM_ERROR_CODEC_OPEN_FAILED, "Could not open video codec");
-            avformat_close_input(&player->format_ctx);
+            close_input(player);
             unlock_state(player);
             return PRISM_ERROR_CODEC_OPEN_FAILED;
         }
 
         player->video_width = player->video_codec_ctx->width;
         player->video_height = player->video_codec_ctx->height;
+
+        /* ABR: output at the largest variant's size, so switching never
+         * changes the texture */
+        if (player->abr_variant_count > 0) {
+            for (int i = 0; i < player->abr_variant_count; i++) {
+                if (player->abr_variants[i].width * player->abr_variants[i].height >
+                    player->video_width * player->video_height) {
+                    player->video_width = player->abr_variants[i].width;
+                    player->video_height = player->abr_variants[i].height;
+                }
+            }
+            player->abr_output_width = player->video_width;
+            player->abr_output_height = player->video_height;
+        }
+        fit_output_size(player->output_max_width, player->output_max_height,
+            &player->video_width, &player->video_height);
         player->video_time_base = av_q2d(video_stream->time_base);
         player->frame_duration = av_q2d(av_inv_q(video_stream->avg_frame_rate));
         if (player->frame_duration <= 0 || player->frame_duration > 1.0) {
@@ -718,30 +3084,39 @@ PRISM_API int prism_player_open_with_options(PrismPlayer* player, const char* ur
         prism_log(1, "Stream info: is_live=%d, frame_duration=%.3fms (%.1f fps)",
             player->is_live, player->frame_duration * 1000.0, 1.0 / player->frame_duration);
 
-        /* Allocate video conversion context */
-        enum AVPixelFormat dst_fmt = AV_PIX_FMT_RGBA;
-        if (player->output_format == PRISM_PIXEL_FORMAT_BGRA) {
-            dst_fmt = AV_PIX_FMT_BGRA;
-        }
+        /* Allocate video conversion context (unused while frames arrive in the output format) */
+        enum AVPixelFormat dst_fmt = get_output_pix_fmt(player->output_format);
 
-        player->sws_ctx = sws_getContext(
-            player->video_width, player->video_height, player->video_codec_ctx->pix_fmt,
-            player->video_width, player->video_height, dst_fmt,
-            SWS_BILINEAR, NULL, NULL, NULL
-        );
+        player->sws_ctx = create_sws_context(player, player->video_codec_ctx->width,
+            player->video_codec_ctx->height, player->video_codec_ctx->pix_fmt, dst_fmt);
+        player->use_yuv_kernel = prism_yuv_kernel_init(&player->yuv_kernel,
+            player->video_codec_ctx->pix_fmt, dst_fmt, av_get_cpu_flags());
+        if (player->use_yuv_kernel) {
+            prism_log(1, "Video: using %s color conversion kernel", player->yuv_kernel.name);
+            start_convert_workers(player);
+        }
+        player->frames_converted = 0;
+        player->convert_ms_last = 0;
+        player->convert_ms_total = 0;
+        player->convert_ms_max = 0;
 
         /* Allocate frames */
         player->frame = av_frame_alloc();
-        player->rgb_frame = av_frame_alloc();
-
-        player->video_buffer_size = av_image_get_buffer_size(dst_fmt, player->video_width, player->video_height, 1);
-        player->video_buffer = (uint8_t*)av_malloc(player->video_buffer_size);
-        player->video_stride = player->video_width * 4;
 
-        av_image_fill_arrays(player->rgb_frame->data, player->rgb_frame->linesize,
-            player->video_buffer, dst_fmt, player->video_width, player->video_height, 1);
-
-        prism_log(1, "Video: %dx%d, codec: %s", player->video_width, player->video_height, codec->name);
+        /* Pool of converted frame buffers: at most one per queue slot, one pinned
+         * for display and one being filled, so steady state never allocates.
+         * Shared with other players of the same size and kept for reopens.
+         * Rows are laid out by frame_align. */
+        player->video_dst_fmt = dst_fmt;
+        player->frame_buffer_size = av_image_get_buffer_size(dst_fmt, player->video_width, player->video_height,
+            frame_align(dst_fmt, player->video_width));
+        player->frame_pool = prism_frame_pool_get(player->frame_buffer_size);
+
+        prism_log(1, "Video: %dx%d, codec: %s, decoder threads: %d (%s)",
+            player->video_width, player->video_height, codec->name,
+            player->video_codec_ctx->thread_count,
+            (player->video_codec_ctx->active_thread_type & FF_THREAD_FRAME) ? "frame" :
+            (player->video_codec_ctx->active_thread_type & FF_THREAD_SLICE) ? "slice" : "none");
     }
 
     /* Initialize audio decoder */
@@ -755,32 +3130,32 @@ PRISM_API int prism_player_open_with_options(PrismPlayer* player, const char* ur
 
             ret = avcodec_open2(player->audio_codec_ctx, codec, NULL);
             if (ret >= 0) {
-                /* Set up audio resampler to output float samples at 48000 Hz stereo (Unity standard) */
-                player->swr_ctx = swr_alloc();
-
-                AVChannelLayout out_ch_layout = AV_CHANNEL_LAYOUT_STEREO;
-                AVChannelLayout in_ch_layout;
-                av_channel_layout_copy(&in_ch_layout, &player->audio_codec_ctx->ch_layout);
-
                 /* Resample to Unity's audio output sample rate (stereo float) */
                 int out_rate = player->output_sample_rate;
                 if (out_rate <= 0) out_rate = 48000;  /* Fallback */
-                swr_alloc_set_opts2(&player->swr_ctx,
-                    &out_ch_layout, AV_SAMPLE_FMT_FLT, out_rate,
-                    &in_ch_layout, player->audio_codec_ctx->sample_fmt, player->audio_codec_ctx->sample_rate,
-                    0, NULL);
-
-                swr_init(player->swr_ctx);
+                player->audio_out_rate = out_rate;
+                configure_resampler(player, &player->audio_codec_ctx->ch_layout,
+                    player->audio_codec_ctx->sample_fmt, player->audio_codec_ctx->sample_rate);
 
                 /* Set audio time base */
                 player->audio_time_base = av_q2d(audio_stream->time_base);
 
-                /* Allocate audio ring buffer (2 seconds of stereo audio for smooth playback) */
-                player->audio_buffer_size = out_rate * 2 * 2;  /* 2 sec stereo */
+                /* Allocate audio ring buffer (at least 2 seconds of stereo audio for smooth playback) */
+                player->audio_buffer_size = round_up_pow2(out_rate * 2 * 2);
+                /* For live, keep less audio buffered (250ms vs 1.5s) */
+                player->audio_fill_target = player->is_live ?
+                    (out_rate * 2 / 4) :        /* ~250ms for live */
+                    (out_rate * 2 * 3 / 2);     /* ~1.5s for VOD */
+                store_release(&player->audio_write_pos, 0);
+                store_release(&player->audio_read_pos, 0);
+                store_release(&player->audio_flush, 0);
                 player->audio_buffer = (float*)av_malloc(player->audio_buffer_size * sizeof(float));
-                player->audio_write_pos = 0;
-                player->audio_read_pos = 0;
-                player->audio_available = 0;
+
+                /* Decode frame and conversion scratch, sized for a generous frame up front */
+                player->audio_frame = av_frame_alloc();
+                int frame_samples = FFMAX(player->audio_codec_ctx->frame_size, 8192);
+                av_fast_malloc(&player->audio_scratch, &player->audio_scratch_size,
+                    swr_get_out_samples(player->swr_ctx, frame_samples) * 2 * sizeof(float));
 
                 prism_log(1, "Audio: source %d Hz %d ch, output %d Hz stereo, codec: %s",
                     player->audio_codec_ctx->sample_rate,
@@ -794,12 +3169,25 @@ PRISM_API int prism_player_open_with_options(PrismPlayer* player, const char* ur
     /* Allocate packet */
     player->packet = av_packet_alloc();
 
+    player->open_ms = (av_gettime_relative() - open_start) / 1000.0;
+    player->probe_ms = probe_ms;
+    player->open_warm = open_warm;
+    prism_log(1, "Open: %.1f ms (%s, stream info probe %.1f ms)",
+        player->open_ms, open_warm ? "warm" : "cold", probe_ms);
+
     player->state = PRISM_STATE_READY;
     player->last_error = PRISM_OK;
     player->first_frame_decoded = false;
     player->first_frame_displayed = false;
 
     unlock_state(player);
+
+    setup_keyframe_index(player, url);
+
+    /* Pipeline threads idle until Play and then live until Close, so commands
+     * posted before Play are applied and seeks keep the decoders warm */
+    start_decoder_threads(player);
+
     prism_log(1, "Media opened successfully");
     return PRISM_OK;
 }
@@ -809,8 +3197,19 @@ PRISM_API void prism_player_close(PrismPlayer* player) {
         return;
     }
 
-    /* Stop decoder thread first (must be done before acquiring lock) */
-    stop_decoder_thread(player);
+    /* Stop pipeline threads first (must be done before acquiring lock). A
+     * demux thread waiting on the read-ahead buffer is released first. */
+    if (player->read_ahead) {
+        prism_read_ahead_abort(player->read_ahead);
+    }
+    stop_decoder_threads(player);
+    stop_convert_workers(player);
+    release_keyframe_index(player);
+
+    if (player->counted) {
+        atomic_add(&g_player_count, -1);
+        player->counted = false;
+    }
 
     lock_state(player);
 
@@ -818,10 +3217,12 @@ PRISM_API void prism_player_close(PrismPlayer* player) {
         sws_freeContext(player->sws_ctx);
         player->sws_ctx = NULL;
     }
+    player->use_yuv_kernel = false;
 
     if (player->swr_ctx) {
         swr_free(&player->swr_ctx);
     }
+    av_channel_layout_uninit(&player->swr_in_layout);
 
     if (player->video_codec_ctx) {
         avcodec_free_context(&player->video_codec_ctx);
@@ -832,17 +3233,20 @@ PRISM_API void prism_player_close(PrismPlayer* player) {
     }
 
     if (player->format_ctx) {
-        avformat_close_input(&player->format_ctx);
+        close_input(player);
     }
 
     if (player->frame) {
         av_frame_free(&player->frame);
     }
 
-    if (player->rgb_frame) {
-        av_frame_free(&player->rgb_frame);
+    if (player->audio_frame) {
+        av_frame_free(&player->audio_frame);
     }
 
+    av_freep(&player->audio_scratch);
+    player->audio_scratch_size = 0;
+
     if (player->packet) {
         av_packet_free(&player->packet);
     }
@@ -852,30 +3256,42 @@ PRISM_API void prism_player_close(PrismPlayer* player) {
         player->audio_buffer = NULL;
     }
 
-    if (player->video_buffer) {
-        av_free(player->video_buffer);
-        player->video_buffer = NULL;
-    }
-
-    /* Clear video queue */
-    lock_queue(player);
-    player->video_queue_write = 0;
-    player->video_queue_read = 0;
-    player->video_queue_count = 0;
-    for (int i = 0; i < VIDEO_QUEUE_SIZE; i++) {
-        player->video_queue[i].valid = false;
+    /* Clear queues and release the displayed frame (pipeline threads are stopped).
+     * The pool itself is freed once the last outstanding buffer is returned. */
+    packet_queue_reset(&player->video_packets);
+    packet_queue_reset(&player->audio_packets);
+    video_ring_reset(player);
+    if (player->display_frame) {
+        av_frame_unref(player->display_frame);
     }
+    player->display_buffer = NULL;
+    player->display_width = 0;
+    player->display_height = 0;
     player->display_ready = false;
-    player->audio_available = 0;
-    player->audio_write_pos = 0;
-    player->audio_read_pos = 0;
-    unlock_queue(player);
+
+    prism_frame_pool_release(&player->frame_pool);
+
+    audio_ring_flush(player);
+
+    /* Forget pending commands; the next media starts a fresh serial */
+    player->command_count = 0;
+    store_release(&player->serial, 0);
+    store_release(&player->completed_serial, 0);
+    player->demux_serial = 0;
+    player->video_serial = 0;
+    player->audio_serial = 0;
+    player->demux_seek_target = -1.0;
 
     player->video_stream_idx = -1;
     player->audio_stream_idx = -1;
+    player->abr_variant_count = 0;
     player->state = PRISM_STATE_IDLE;
     player->first_frame_decoded = false;
     player->first_frame_displayed = false;
+    player->prerolling = false;
+    player->preroll_done = false;
+    player->poster_pending = false;
+    player->poster_shown = false;
 
     unlock_state(player);
 }
@@ -894,21 +3310,87 @@ PRISM_API int prism_player_play(PrismPlayer* player) {
         return PRISM_ERROR_NOT_READY;
     }
 
-    /* Initialize playback clock */
+    /* Initialize playback clock. After Prepare the clock starts at the
+     * poster frame, so the frames queued behind it play on schedule. */
     player->playback_start_time = av_gettime();
     player->start_pts = player->current_pts;
+    if (player->poster_shown) {
+        player->start_pts = player->display_pts;
+        player->first_frame_displayed = true;
+    }
+    player->poster_pending = false;
+    player->poster_shown = false;
+    player->prerolling = false;
     player->state = PRISM_STATE_PLAYING;
     unlock_state(player);
 
-    /* Start decoder thread if not already running */
+    /* Start pipeline threads if not already running, otherwise wake them */
     if (!player->decoder_running) {
-        start_decoder_thread(player);
+        start_decoder_threads(player);
+    } else {
+        wake_pipeline(player);
     }
 
     prism_log(1, "Playback started");
     return PRISM_OK;
 }
 
+PRISM_API int prism_player_prepare(PrismPlayer* player) {
+    if (!player) {
+        return PRISM_ERROR_INVALID_PLAYER;
+    }
+
+    lock_state(player);
+
+    if (player->state != PRISM_STATE_READY &&
+        player->state != PRISM_STATE_PAUSED &&
+        player->state != PRISM_STATE_STOPPED) {
+        unlock_state(player);
+        return PRISM_ERROR_NOT_READY;
+    }
+
+    player->prerolling = true;
+    player->preroll_done = false;
+    player->preroll_started = false;
+    player->poster_pending = player->video_codec_ctx != NULL;
+    unlock_state(player);
+
+    /* Threads are already running (started at Open); let the demuxer read */
+    if (!player->decoder_running) {
+        start_decoder_threads(player);
+    } else {
+        wake_pipeline(player);
+    }
+
+    prism_log(1, "Preparing (preroll %.2f s)", player->preroll_seconds);
+    return PRISM_OK;
+}
+
+PRISM_API bool prism_player_is_prepared(PrismPlayer* player) {
+    if (!player) {
+        return false;
+    }
+
+    lock_state(player);
+    bool buffered = player->preroll_done;
+    unlock_state(player);
+
+    /* A full frame ring also counts: the decoder cannot run further ahead */
+    if (player->video_codec_ctx) {
+        buffered = buffered || video_ring_count(player) == VIDEO_QUEUE_SIZE;
+        return buffered && player->poster_shown;
+    }
+    return buffered;
+}
+
+PRISM_API void prism_player_set_preroll(PrismPlayer* player, double seconds) {
+    if (player) {
+        lock_state(player);
+        player->preroll_seconds = (seconds > 0) ? seconds : 0;
+        unlock_state(player);
+    }
+}
+
 PRISM_API int prism_player_pause(PrismPlayer* player) {
     if (!player) {
         return PRISM_ERROR_INVALID_PLAYER;
@@ -918,7 +3400,7 @@ PRISM_API int prism_player_pause(PrismPlayer* player) {
 
     if (player->state == PRISM_STATE_PLAYING) {
         player->state = PRISM_STATE_PAUSED;
-        /* Note: decoder thread will notice the state change and sleep */
+        /* Note: demux thread will notice the state change and sleep until Play */
     }
 
     unlock_state(player);
@@ -930,46 +3412,35 @@ PRISM_API int prism_player_stop(PrismPlayer* player) {
         return PRISM_ERROR_INVALID_PLAYER;
     }
 
-    /* Stop decoder thread first */
-    stop_decoder_thread(player);
-
     lock_state(player);
 
+    /* The demux thread rewinds and the decoders flush in the background */
     if (player->format_ctx) {
-        av_seek_frame(player->format_ctx, -1, 0, AVSEEK_FLAG_BACKWARD);
-        if (player->video_codec_ctx) {
-            avcodec_flush_buffers(player->video_codec_ctx);
-        }
-        if (player->audio_codec_ctx) {
-            avcodec_flush_buffers(player->audio_codec_ctx);
-        }
+        post_command(player, COMMAND_STOP, 0, PRISM_SEEK_KEYFRAME);
     }
 
     player->current_pts = 0;
     player->first_frame_decoded = false;
     player->first_frame_displayed = false;
+    player->prerolling = false;
+    player->preroll_done = false;
+    player->poster_pending = false;
+    player->poster_shown = false;
     player->state = PRISM_STATE_STOPPED;
 
     unlock_state(player);
 
-    /* Clear queues */
-    lock_queue(player);
-    player->video_queue_write = 0;
-    player->video_queue_read = 0;
-    player->video_queue_count = 0;
-    for (int i = 0; i < VIDEO_QUEUE_SIZE; i++) {
-        player->video_queue[i].valid = false;
-    }
     player->display_ready = false;
-    player->audio_available = 0;
-    player->audio_write_pos = 0;
-    player->audio_read_pos = 0;
-    unlock_queue(player);
+    wake_pipeline(player);
 
     return PRISM_OK;
 }
 
 PRISM_API int prism_player_seek(PrismPlayer* player, double position_seconds) {
+    return prism_player_seek_with_mode(player, position_seconds, PRISM_SEEK_KEYFRAME);
+}
+
+PRISM_API int prism_player_seek_with_mode(PrismPlayer* player, double position_seconds, PrismSeekMode mode) {
     if (!player || !player->format_ctx) {
         return PRISM_ERROR_INVALID_PLAYER;
     }
@@ -978,58 +3449,37 @@ PRISM_API int prism_player_seek(PrismPlayer* player, double position_seconds) {
         return PRISM_ERROR_SEEK_FAILED;  /* Can't seek in live streams */
     }
 
-    /* Stop decoder thread during seek to avoid race conditions */
-    bool was_running = player->decoder_running;
-    if (was_running) {
-        stop_decoder_thread(player);
-    }
-
     lock_state(player);
 
-    int64_t timestamp = (int64_t)(position_seconds * AV_TIME_BASE);
-    int ret = av_seek_frame(player->format_ctx, -1, timestamp, AVSEEK_FLAG_BACKWARD);
+    post_command(player, COMMAND_SEEK, position_seconds, mode);
 
-    if (ret < 0) {
-        unlock_state(player);
-        if (was_running && player->state == PRISM_STATE_PLAYING) {
-            start_decoder_thread(player);
-        }
-        return PRISM_ERROR_SEEK_FAILED;
+    player->current_pts = position_seconds;
+    player->first_frame_decoded = false;
+    if (player->state == PRISM_STATE_END_OF_FILE) {
+        player->state = PRISM_STATE_PLAYING;  /* Resume from the new position */
     }
 
-    if (player->video_codec_ctx) {
-        avcodec_flush_buffers(player->video_codec_ctx);
-    }
-    if (player->audio_codec_ctx) {
-        avcodec_flush_buffers(player->audio_codec_ctx);
+    /* A prepared player prerolls again and shows a poster at the new position */
+    if (player->state != PRISM_STATE_PLAYING && (player->prerolling || player->poster_shown)) {
+        player->prerolling = true;
+        player->preroll_done = false;
+        player->preroll_started = false;
+        player->poster_pending = player->video_codec_ctx != NULL;
+        player->poster_shown = false;
     }
 
-    player->current_pts = position_seconds;
-    player->first_frame_decoded = false;
-    player->first_frame_displayed = false;  /* Re-sync clock on next frame */
-
     unlock_state(player);
 
-    /* Clear video queue and audio buffer */
-    lock_queue(player);
-    player->video_queue_write = 0;
-    player->video_queue_read = 0;
-    player->video_queue_count = 0;
-    for (int i = 0; i < VIDEO_QUEUE_SIZE; i++) {
-        player->video_queue[i].valid = false;
-    }
-    player->display_ready = false;
-    player->audio_available = 0;
-    player->audio_write_pos = 0;
-    player->audio_read_pos = 0;
-    unlock_queue(player);
+    wake_pipeline(player);
+    return PRISM_OK;
+}
 
-    /* Restart decoder thread if it was running */
-    if (was_running && player->state == PRISM_STATE_PLAYING) {
-        start_decoder_thread(player);
-    }
+PRISM_API uint32_t prism_player_get_command_serial(PrismPlayer* player) {
+    return player ? load_acquire(&player->serial) : 0;
+}
 
-    return PRISM_OK;
+PRISM_API uint32_t prism_player_get_completed_serial(PrismPlayer* player) {
+    return player ? load_acquire(&player->completed_serial) : 0;
 }
 
 /* ============================================================================
@@ -1089,6 +3539,84 @@ PRISM_API bool prism_player_get_audio_info(PrismPlayer* player, PrismAudioInfo*
     return true;
 }
 
+PRISM_API bool prism_player_get_stats(PrismPlayer* player, PrismPlayerStats* stats) {
+    if (!player || !stats) {
+        return false;
+    }
+
+    lock_state(player);
+    stats->frames_converted = player->frames_converted;
+    stats->convert_ms_last = player->convert_ms_last;
+    stats->convert_ms_avg = player->frames_converted > 0 ?
+        player->convert_ms_total / player->frames_converted : 0.0;
+    stats->convert_ms_max = player->convert_ms_max;
+    stats->convert_threads = player->sws_ctx ? player->convert_threads : 0;
+    stats->decode_threads = player->video_codec_ctx ? player->video_codec_ctx->thread_count : 0;
+    stats->index_keyframes = player->index_keyframes;
+    stats->open_ms = player->open_ms;
+    stats->probe_ms = player->probe_ms;
+    stats->open_warm = player->open_warm ? 1 : 0;
+    stats->live_latency = player->live_latency;
+    stats->live_rate = player->live_rate;
+    stats->live_frames_dropped = player->live_frames_dropped;
+
+    PrismReadAheadStats io;
+    memset(&io, 0, sizeof(io));
+    if (player->read_ahead) {
+        prism_read_ahead_get_stats(player->read_ahead, &io);
+    }
+    stats->read_ahead_buffered = io.buffered;
+    stats->read_ahead_fill_rate = io.fill_rate;
+    stats->read_ahead_stalls = io.stalls;
+    stats->demux_read_ms = player->demux_read_us / 1000.0;
+    stats->demux_bytes = player->demux_bytes;
+    stats->file_backend = player->mapped_file ? PRISM_FILE_BACKEND_MMAP : PRISM_FILE_BACKEND_DEFAULT;
+    unlock_state(player);
+
+    return true;
+}
+
+PRISM_API bool prism_player_get_abr_info(PrismPlayer* player, PrismAbrInfo* info) {
+    if (!player || !info) {
+        return false;
+    }
+
+    memset(info, 0, sizeof(*info));
+    lock_state(player);
+    info->active = player->abr_variant_count > 0 ? 1 : 0;
+    info->variant_count = player->abr_variant_count;
+    if (info->active) {
+        info->current_variant = player->abr_current;
+        info->current_bitrate = player->abr_variants[player->abr_current].bitrate;
+    }
+    info->bandwidth = player->abr_bandwidth;
+    info->decode_ms = player->decode_ms_avg + (player->frames_converted > 0 ?
+        player->convert_ms_total / player->frames_converted : 0.0);
+    info->switches = player->abr_switches;
+    info->last_reason = player->abr_last_reason;
+    info->last_switch_time = player->abr_last_switch_time;
+    unlock_state(player);
+
+    return true;
+}
+
+PRISM_API bool prism_player_get_abr_variant(PrismPlayer* player, int index, PrismAbrVariant* variant) {
+    if (!player || !variant) {
+        return false;
+    }
+
+    lock_state(player);
+    bool valid = index >= 0 && index < player->abr_variant_count;
+    if (valid) {
+        variant->bitrate = player->abr_variants[index].bitrate;
+        variant->width = player->abr_variants[index].width;
+        variant->height = player->abr_variants[index].height;
+    }
+    unlock_state(player);
+
+    return valid;
+}
+
 PRISM_API double prism_player_get_position(PrismPlayer* player) {
     return player ? player->current_pts : 0.0;
 }
@@ -1105,15 +3633,66 @@ PRISM_API bool prism_player_is_live(PrismPlayer* player) {
  * Frame Access
  * ========================================================================== */
 
-/* Helper to write samples to audio ring buffer */
-static void audio_ring_write(PrismPlayer* player, float* samples, int count) {
-    for (int i = 0; i < count; i++) {
-        if (player->audio_available < player->audio_buffer_size) {
-            /* Don't apply volume here - let Unity handle it for consistency */
-            player->audio_buffer[player->audio_write_pos] = samples[i];
-            player->audio_write_pos = (player->audio_write_pos + 1) % player->audio_buffer_size;
-            player->audio_available++;
-        }
+/* Move a queued frame to the display and hand its slot back to the decoder.
+ * The previously displayed frame's buffers are released (back to the pool). */
+static void show_video_entry(PrismPlayer* player, VideoFrameEntry* entry) {
+    av_frame_unref(player->display_frame);
+    av_frame_move_ref(player->display_frame, entry->frame);
+
+    bool resized = player->display_width != player->display_frame->width ||
+                   player->display_height != player->display_frame->height;
+
+    player->display_buffer = player->display_frame->data[0];
+    player->display_width = player->display_frame->width;
+    player->display_height = player->display_frame->height;
+    player->display_stride = player->display_frame->linesize[0];
+    player->display_pts = entry->pts;
+    player->display_ready = true;
+
+    video_ring_pop(player);
+
+    if (resized && player->video_size_callback) {
+        player->video_size_callback(player->video_size_callback_user_data,
+            player->display_width, player->display_height);
+    }
+}
+
+static void notify_video_callback(PrismPlayer* player) {
+    if (player->video_callback) {
+        player->video_callback(
+            player->video_callback_user_data,
+            player->display_buffer,
+            player->display_width,
+            player->display_height,
+            player->display_stride,
+            player->display_pts
+        );
+    }
+}
+
+/* Low latency: steer the playback rate towards the target latency */
+static void update_live_rate(PrismPlayer* player, double live_edge) {
+    double latency = live_edge - player->display_pts;
+    double error = latency - player->target_latency;
+
+    double rate = 1.0;
+    if (error > LIVE_RATE_DEADBAND || error < -LIVE_RATE_DEADBAND) {
+        rate = FFMIN(FFMAX(1.0 + error * LIVE_RATE_GAIN, LIVE_RATE_MIN), LIVE_RATE_MAX);
+    }
+    player->live_rate += (rate - player->live_rate) * LIVE_RATE_SMOOTHING;
+    player->live_latency = latency;
+    store_release(&player->live_rate_permyriad, (unsigned int)(player->live_rate * 10000.0 + 0.5));
+}
+
+/* Low latency: drop queued frames that are further behind the live edge
+ * than rate control can recover, keeping at least one to show */
+static void drop_late_live_frames(PrismPlayer* player, double live_edge) {
+    double limit = player->target_latency + LIVE_DROP_MARGIN;
+    VideoFrameEntry* entry;
+    while (video_ring_count(player) > 1 && (entry = video_ring_peek(player)) != NULL &&
+           live_edge - entry->pts > limit) {
+        video_ring_discard(player);
+        player->live_frames_dropped++;
     }
 }
 
@@ -1122,10 +3701,32 @@ PRISM_API int prism_player_update(PrismPlayer* player, double delta_time) {
         return 0;
     }
 
+    /* Return slots holding frames from before the newest Seek/Stop, even
+     * while paused, so the decoder can refill the ring */
+    unsigned int serial = load_acquire(&player->serial);
+    VideoFrameEntry* stale;
+    while ((stale = video_ring_peek(player)) != NULL && stale->serial != serial) {
+        video_ring_discard(player);
+    }
+
     /* Check state without holding lock for quick exit */
     PrismState current_state = player->state;
     if (current_state != PRISM_STATE_PLAYING && current_state != PRISM_STATE_END_OF_FILE) {
-        return 0;
+        /* Prepare: show the first decoded frame as a poster image */
+        VideoFrameEntry* poster = player->poster_pending ? video_ring_peek(player) : NULL;
+        if (poster == NULL) {
+            return 0;
+        }
+
+        show_video_entry(player, poster);
+        player->poster_pending = false;
+        player->poster_shown = true;
+        player->video_pts = player->display_pts;
+        player->current_pts = player->display_pts;
+        prism_log(1, "Poster frame ready, PTS: %.3f", player->display_pts);
+
+        notify_video_callback(player);
+        return 1;
     }
 
     int frames_ready = 0;
@@ -1136,11 +3737,11 @@ PRISM_API int prism_player_update(PrismPlayer* player, double delta_time) {
     int64_t elapsed_us = av_gettime() - player->playback_start_time;
     double playback_time = player->start_pts + (elapsed_us / 1000000.0) * player->speed;
     bool is_live = player->is_live;
+    double live_edge = player->live_edge_pts;
     unlock_state(player);
 
-    /* Pull frames from video queue based on timing - this is non-blocking */
-    lock_queue(player);
-
+    /* Pull frames from video queue based on timing - lock-free, the decoder
+     * thread keeps filling other slots while we consume this one */
     if (is_live) {
         /* LIVE STREAM MODE: Pace display to stream's frame rate.
          * Use a target-based timing system to prevent drift.
@@ -1149,34 +3750,19 @@ PRISM_API int prism_player_update(PrismPlayer* player, double delta_time) {
         VideoFrameEntry* frame_to_show = NULL;
 
         int64_t now = av_gettime();
-        /* frame_duration is in seconds, convert to microseconds */
+        /* frame_duration is in seconds, convert to microseconds. Low latency
+         * paces at the catch-up rate. */
         int64_t frame_interval_us = (int64_t)(player->frame_duration * 1000000.0);
+        if (player->low_latency_active) {
+            frame_interval_us = (int64_t)(frame_interval_us / player->live_rate);
+        }
 
         /* First frame: initialize timing and display immediately */
         if (!player->first_frame_displayed) {
-            if (player->video_queue_count > 0) {
-                int idx = player->video_queue_read;
-                VideoFrameEntry* entry = &player->video_queue[idx];
-                if (entry->valid) {
-                    frame_to_show = entry;
-                    player->video_queue_read = (player->video_queue_read + 1) % VIDEO_QUEUE_SIZE;
-                    player->video_queue_count--;
-                }
-            }
+            frame_to_show = video_ring_peek(player);
 
             if (frame_to_show != NULL) {
-                int frame_size = frame_to_show->width * frame_to_show->height * 4;
-                if (!player->display_buffer) {
-                    player->display_buffer = (uint8_t*)av_malloc(frame_size);
-                }
-
-                memcpy(player->display_buffer, frame_to_show->data, frame_size);
-                player->display_width = frame_to_show->width;
-                player->display_height = frame_to_show->height;
-                player->display_stride = frame_to_show->stride;
-                player->display_pts = frame_to_show->pts;
-                player->display_ready = true;
-                frame_to_show->valid = false;
+                show_video_entry(player, frame_to_show);
 
                 player->first_frame_displayed = true;
                 player->start_pts = player->display_pts;
@@ -1189,18 +3775,8 @@ PRISM_API int prism_player_update(PrismPlayer* player, double delta_time) {
 
                 prism_log(1, "Live: First frame displayed, frame_duration=%.3fms", player->frame_duration * 1000.0);
 
-                if (player->video_callback) {
-                    player->video_callback(
-                        player->video_callback_user_data,
-                        player->display_buffer,
-                        player->display_width,
-                        player->display_height,
-                        player->display_stride,
-                        player->display_pts
-                    );
-                }
+                notify_video_callback(player);
             }
-            unlock_queue(player);
             return frames_ready;
         }
 
@@ -1208,7 +3784,6 @@ PRISM_API int prism_player_update(PrismPlayer* player, double delta_time) {
         int64_t next_frame_time = player->last_frame_display_time + frame_interval_us;
         if (now < next_frame_time) {
             /* Not time yet */
-            unlock_queue(player);
             return 0;
         }
 
@@ -1220,40 +3795,23 @@ PRISM_API int prism_player_update(PrismPlayer* player, double delta_time) {
             prism_log(1, "Live: Reset timing, was %.1fms behind", lateness / 1000.0);
         }
 
-        /* If we have more than 2 frames queued, we're behind - skip to newest */
-        while (player->video_queue_count > 2) {
-            int idx = player->video_queue_read;
-            player->video_queue[idx].valid = false;  /* Drop old frame */
-            player->video_queue_read = (player->video_queue_read + 1) % VIDEO_QUEUE_SIZE;
-            player->video_queue_count--;
+        if (player->low_latency_active) {
+            /* Rate control absorbs normal drift; only frames past the hard
+             * threshold are dropped */
+            drop_late_live_frames(player, live_edge);
+        } else {
+            /* If we have more than 2 frames queued, we're behind - skip to newest */
+            while (video_ring_count(player) > 2) {
+                video_ring_discard(player);  /* Drop old frame */
+            }
         }
 
         /* Take one frame if available */
-        if (player->video_queue_count > 0) {
-            int idx = player->video_queue_read;
-            VideoFrameEntry* entry = &player->video_queue[idx];
-
-            if (entry->valid) {
-                frame_to_show = entry;
-                player->video_queue_read = (player->video_queue_read + 1) % VIDEO_QUEUE_SIZE;
-                player->video_queue_count--;
-            }
-        }
+        frame_to_show = video_ring_peek(player);
 
         /* Display the frame if we have one */
         if (frame_to_show != NULL) {
-            int frame_size = frame_to_show->width * frame_to_show->height * 4;
-            if (!player->display_buffer) {
-                player->display_buffer = (uint8_t*)av_malloc(frame_size);
-            }
-
-            memcpy(player->display_buffer, frame_to_show->data, frame_size);
-            player->display_width = frame_to_show->width;
-            player->display_height = frame_to_show->height;
-            player->display_stride = frame_to_show->stride;
-            player->display_pts = frame_to_show->pts;
-            player->display_ready = true;
-            frame_to_show->valid = false;
+            show_video_entry(player, frame_to_show);
 
             frames_ready = 1;
 
@@ -1261,17 +3819,11 @@ PRISM_API int prism_player_update(PrismPlayer* player, double delta_time) {
             player->last_frame_display_time += frame_interval_us;
             player->video_pts = player->display_pts;
             player->current_pts = player->display_pts;
-
-            if (player->video_callback) {
-                player->video_callback(
-                    player->video_callback_user_data,
-                    player->display_buffer,
-                    player->display_width,
-                    player->display_height,
-                    player->display_stride,
-                    player->display_pts
-                );
+            if (player->low_latency_active) {
+                update_live_rate(player, live_edge);
             }
+
+            notify_video_callback(player);
         } else {
             /* No frame available but we needed one - advance timing anyway
              * to maintain cadence when frames do arrive */
@@ -1281,38 +3833,22 @@ PRISM_API int prism_player_update(PrismPlayer* player, double delta_time) {
         /* VOD MODE: Respect timing for smooth playback */
         bool need_clock_sync = !player->first_frame_displayed;
 
-        while (player->video_queue_count > 0) {
-            int idx = player->video_queue_read;
-            VideoFrameEntry* entry = &player->video_queue[idx];
-
-            if (!entry->valid) {
-                player->video_queue_read = (player->video_queue_read + 1) % VIDEO_QUEUE_SIZE;
-                player->video_queue_count--;
-                continue;
-            }
-
+        VideoFrameEntry* entry = video_ring_peek(player);
+        if (entry != NULL && entry->resync) {
+            /* Stream looped: the new pass starts its own clock */
+            player->first_frame_displayed = false;
+            need_clock_sync = true;
+        }
+        if (entry != NULL) {
             /* First frame: always display and sync clock */
             /* Subsequent frames: check timing */
             double time_diff = entry->pts - playback_time;
             bool should_display = need_clock_sync || (time_diff <= 0.016);
 
+            /* Frame is early - leave it queued and wait */
             if (should_display) {
-                /* Frame is due - copy to display buffer */
-                int frame_size = entry->width * entry->height * 4;
-                if (!player->display_buffer) {
-                    player->display_buffer = (uint8_t*)av_malloc(frame_size);
-                }
-
-                memcpy(player->display_buffer, entry->data, frame_size);
-                player->display_width = entry->width;
-                player->display_height = entry->height;
-                player->display_stride = entry->stride;
-                player->display_pts = entry->pts;
-                player->display_ready = true;
-
-                entry->valid = false;
-                player->video_queue_read = (player->video_queue_read + 1) % VIDEO_QUEUE_SIZE;
-                player->video_queue_count--;
+                /* Frame is due - hand it to the display */
+                show_video_entry(player, entry);
 
                 /* Sync clock on first frame DISPLAY */
                 if (!player->first_frame_displayed) {
@@ -1326,27 +3862,11 @@ PRISM_API int prism_player_update(PrismPlayer* player, double delta_time) {
 
                 frames_ready = 1;
 
-                if (player->video_callback) {
-                    player->video_callback(
-                        player->video_callback_user_data,
-                        player->display_buffer,
-                        player->display_width,
-                        player->display_height,
-                        player->display_stride,
-                        player->display_pts
-                    );
-                }
-
-                break;
-            } else {
-                /* Frame is early - wait */
-                break;
+                notify_video_callback(player);
             }
         }
     }
 
-    unlock_queue(player);
-
     return frames_ready;
 }
 
@@ -1355,11 +3875,8 @@ PRISM_API uint8_t* prism_player_get_video_frame(PrismPlayer* player, int* out_wi
         return NULL;
     }
 
-    lock_queue(player);
-
     /* Only return frame if display is ready */
     if (!player->display_ready || !player->display_buffer) {
-        unlock_queue(player);
         return NULL;
     }
 
@@ -1370,11 +3887,62 @@ PRISM_API uint8_t* prism_player_get_video_frame(PrismPlayer* player, int* out_wi
     /* Mark as consumed so we don't return the same frame twice */
     player->display_ready = false;
 
-    unlock_queue(player);
-
     return player->display_buffer;
 }
 
+PRISM_API bool prism_player_get_video_planes(PrismPlayer* player, PrismVideoPlanes* planes) {
+    if (!player || !planes) {
+        return false;
+    }
+
+    AVFrame* frame = player->display_frame;
+    if (!player->display_ready || !frame || !frame->data[0]) {
+        return false;
+    }
+
+    memset(planes, 0, sizeof(*planes));
+    planes->format = player->output_format;
+    planes->width = frame->width;
+    planes->height = frame->height;
+
+    switch (player->output_format) {
+        case PRISM_PIXEL_FORMAT_YUV420P: planes->plane_count = 3; break;
+        case PRISM_PIXEL_FORMAT_NV12:    planes->plane_count = 2; break;
+        default:                         planes->plane_count = 1; break;
+    }
+    for (int i = 0; i < planes->plane_count; i++) {
+        planes->data[i] = frame->data[i];
+        planes->stride[i] = frame->linesize[i];
+    }
+
+    /* Colorimetry for shader-side conversion. Untagged streams follow the
+     * usual convention: BT.709 for HD and up, BT.601 below. */
+    switch (frame->colorspace) {
+        case AVCOL_SPC_BT709:
+            planes->matrix = PRISM_COLOR_MATRIX_BT709;
+            break;
+        case AVCOL_SPC_BT2020_NCL:
+        case AVCOL_SPC_BT2020_CL:
+            planes->matrix = PRISM_COLOR_MATRIX_BT2020;
+            break;
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:
+            planes->matrix = PRISM_COLOR_MATRIX_BT601;
+            break;
+        default:
+            planes->matrix = (frame->height >= 720) ? PRISM_COLOR_MATRIX_BT709 : PRISM_COLOR_MATRIX_BT601;
+            break;
+    }
+    planes->range = (frame->color_range == AVCOL_RANGE_JPEG || frame->format == AV_PIX_FMT_YUVJ420P) ?
+        PRISM_COLOR_RANGE_FULL : PRISM_COLOR_RANGE_LIMITED;
+    planes->pts = player->display_pts;
+
+    /* Mark as consumed, same as get_video_frame */
+    player->display_ready = false;
+
+    return true;
+}
+
 PRISM_API double prism_player_get_video_pts(PrismPlayer* player) {
     return player ? player->video_pts : 0.0;
 }
@@ -1384,14 +3952,37 @@ PRISM_API int prism_player_copy_video_frame(PrismPlayer* player, uint8_t* dest_b
         return PRISM_ERROR_INVALID_PARAMETER;
     }
 
-    lock_queue(player);
-
     if (!player->display_buffer || !player->display_ready) {
-        unlock_queue(player);
         return PRISM_ERROR_INVALID_PARAMETER;
     }
 
-    if (dest_stride == player->display_stride) {
+    if (player->output_format == PRISM_PIXEL_FORMAT_YUV420P ||
+        player->output_format == PRISM_PIXEL_FORMAT_NV12) {
+        /* Planar: planes are written back to back (I420 / NV12 layout),
+         * chroma rows use dest_stride / 2 (YUV420P) or dest_stride (NV12) */
+        AVFrame* frame = player->display_frame;
+        int width = frame->width;
+        int height = frame->height;
+        int chroma_height = (height + 1) / 2;
+        uint8_t* dest = dest_buffer;
+
+        av_image_copy_plane(dest, dest_stride, frame->data[0], frame->linesize[0],
+            FFMIN(width, dest_stride), height);
+        dest += dest_stride * height;
+
+        if (player->output_format == PRISM_PIXEL_FORMAT_NV12) {
+            av_image_copy_plane(dest, dest_stride, frame->data[1], frame->linesize[1],
+                FFMIN(((width + 1) / 2) * 2, dest_stride), chroma_height);
+        } else {
+            int chroma_stride = dest_stride / 2;
+            int chroma_width = FFMIN((width + 1) / 2, chroma_stride);
+            av_image_copy_plane(dest, chroma_stride, frame->data[1], frame->linesize[1],
+                chroma_width, chroma_height);
+            dest += chroma_stride * chroma_height;
+            av_image_copy_plane(dest, chroma_stride, frame->data[2], frame->linesize[2],
+                chroma_width, chroma_height);
+        }
+    } else if (dest_stride == player->display_stride) {
         memcpy(dest_buffer, player->display_buffer, player->display_height * player->display_stride);
     } else {
         /* Copy row by row if strides differ */
@@ -1401,7 +3992,6 @@ PRISM_API int prism_player_copy_video_frame(PrismPlayer* player, uint8_t* dest_b
         }
     }
 
-    unlock_queue(player);
     return PRISM_OK;
 }
 
@@ -1414,18 +4004,11 @@ PRISM_API int prism_player_get_audio_samples(PrismPlayer* player, float* buffer,
         return 0;
     }
 
-    lock_queue(player);
-
-    int to_copy = (player->audio_available < max_samples) ? player->audio_available : max_samples;
-
-    for (int i = 0; i < to_copy; i++) {
-        buffer[i] = player->audio_buffer[player->audio_read_pos];
-        player->audio_read_pos = (player->audio_read_pos + 1) % player->audio_buffer_size;
+    if (max_samples <= 0) {
+        return 0;
     }
-    player->audio_available -= to_copy;
 
-    unlock_queue(player);
-    return to_copy;
+    return audio_ring_read(player, buffer, max_samples);
 }
 
 PRISM_API int prism_player_get_audio_sample_rate(PrismPlayer* player) {
@@ -1456,6 +4039,21 @@ PRISM_API void prism_player_set_pixel_format(PrismPlayer* player, PrismPixelForm
     }
 }
 
+PRISM_API void prism_player_set_output_size(PrismPlayer* player, int width, int height) {
+    if (player) {
+        lock_state(player);
+        player->output_max_width = FFMAX(width, 0);
+        player->output_max_height = FFMAX(height, 0);
+        unlock_state(player);
+    }
+}
+
+PRISM_API void prism_player_set_lowres(PrismPlayer* player, bool enabled) {
+    if (player) {
+        player->lowres_enabled = enabled;
+    }
+}
+
 PRISM_API void prism_player_set_loop(PrismPlayer* player, bool loop) {
     if (player) {
         player->loop = loop;
@@ -1492,6 +4090,64 @@ PRISM_API void prism_player_set_hardware_acceleration(PrismPlayer* player, bool
     }
 }
 
+PRISM_API void prism_player_set_decode_threads(PrismPlayer* player, PrismThreadMode mode, int thread_count) {
+    if (player) {
+        player->decode_thread_mode = mode;
+        player->decode_thread_count = (thread_count > 0) ? thread_count : 0;
+    }
+}
+
+PRISM_API int prism_player_get_decode_threads(PrismPlayer* player) {
+    return (player && player->video_codec_ctx) ? player->video_codec_ctx->thread_count : 0;
+}
+
+PRISM_API void prism_player_set_open_profile(PrismPlayer* player, PrismOpenProfile profile) {
+    if (player) {
+        player->open_profile = profile;
+    }
+}
+
+PRISM_API void prism_player_set_low_latency(PrismPlayer* player, bool enabled, double target_latency) {
+    if (player) {
+        player->low_latency = enabled;
+        player->target_latency = (target_latency > 0) ? target_latency : LIVE_DEFAULT_LATENCY;
+    }
+}
+
+PRISM_API void prism_player_set_convert_threads(PrismPlayer* player, int thread_count) {
+    if (player) {
+        player->convert_thread_count = (thread_count > 0) ? thread_count : 0;
+    }
+}
+
+PRISM_API int prism_player_get_convert_threads(PrismPlayer* player) {
+    return (player && player->sws_ctx) ? player->convert_threads : 0;
+}
+
+PRISM_API void prism_player_set_keyframe_index(PrismPlayer* player, bool enabled) {
+    if (player) {
+        player->keyframe_index_enabled = enabled;
+    }
+}
+
+PRISM_API void prism_player_set_read_ahead(PrismPlayer* player, int64_t size_bytes) {
+    if (player) {
+        player->read_ahead_size = (size_bytes > 0) ? (size_t)size_bytes : 0;
+    }
+}
+
+PRISM_API void prism_player_set_file_backend(PrismPlayer* player, PrismFileBackend backend) {
+    if (player) {
+        player->file_backend = backend;
+    }
+}
+
+PRISM_API void prism_player_set_abr(PrismPlayer* player, bool enabled) {
+    if (player) {
+        player->abr_enabled = enabled;
+    }
+}
+
 /* ============================================================================
  * Callbacks
  * ========================================================================== */
@@ -1503,9 +4159,426 @@ PRISM_API void prism_player_set_video_callback(PrismPlayer* player, PrismVideoFr
     }
 }
 
+PRISM_API void prism_player_set_video_size_callback(PrismPlayer* player, PrismVideoSizeCallback callback, void* user_data) {
+    if (player) {
+        player->video_size_callback = callback;
+        player->video_size_callback_user_data = user_data;
+    }
+}
+
 PRISM_API void prism_player_set_audio_callback(PrismPlayer* player, PrismAudioSamplesCallback callback, void* user_data) {
     if (player) {
         player->audio_callback = callback;
         player->audio_callback_user_data = user_data;
     }
 }
+
+/* ============================================================================
+ * Thumbnails
+ *
+ * Each worker opens its own demuxer and decoder, claims thumbnails one at a
+ * time, seeks to the keyframe before each one's time and decodes just that
+ * keyframe (drained immediately, so B-frame delay does not matter), scaling
+ * it straight into its tile of the shared atlas. Tiles never overlap, so
+ * workers need no locking.
+ * ========================================================================== */
+
+typedef struct ThumbnailJob {
+    const char* url;
+    double duration;
+    enum AVPixelFormat dst_fmt;
+    PrismThumbnails* result;
+    prism_atomic_t next;        /* Next thumbnail to claim */
+    prism_atomic_t decoded;     /* Keyframes actually decoded */
+} ThumbnailJob;
+
+static int open_thumbnail_input(AVFormatContext** ctx, const char* url) {
+    AVDictionary* opts = NULL;
+    if (strstr(url, "m3u8")) {
+        av_dict_set(&opts, "protocol_whitelist", "file,http,https,tcp,tls,crypto", 0);
+    }
+    int ret = avformat_open_input(ctx, url, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = avformat_find_stream_info(*ctx, NULL);
+    if (ret < 0) {
+        avformat_close_input(ctx);
+    }
+    return ret;
+}
+
+/* Resolve uri relative to the playlist at base. Caller frees with av_free. */
+static char* resolve_playlist_uri(const char* base, const char* uri, size_t uri_len) {
+    bool absolute = false;
+    for (size_t i = 0; i + 3 <= uri_len && !absolute; i++) {
+        absolute = memcmp(uri + i, "://", 3) == 0;
+    }
+
+    size_t prefix = 0;
+    if (!absolute) {
+        const char* scheme_end = strstr(base, "://");
+        if (uri[0] == '/' && scheme_end) {
+            /* Host-relative: keep scheme and host */
+            const char* path = strchr(scheme_end + 3, '/');
+            prefix = path ? (size_t)(path - base) : strlen(base);
+        } else if (uri[0] != '/') {
+            const char* slash = strrchr(base, '/');
+            prefix = slash ? (size_t)(slash - base + 1) : 0;
+        }
+    }
+
+    char* result = (char*)av_malloc(prefix + uri_len + 1);
+    if (result) {
+        memcpy(result, base, prefix);
+        memcpy(result + prefix, uri, uri_len);
+        result[prefix + uri_len] = '\0';
+    }
+    return result;
+}
+
+/* Return the lowest-bandwidth I-frame playlist (#EXT-X-I-FRAME-STREAM-INF)
+ * of a HLS master playlist, or NULL. Its segments are single keyframes, so
+ * thumbnails fetch only the bytes they decode. Caller frees with av_free. */
+static char* find_iframe_playlist(const char* url) {
+    if (!strstr(url, "m3u8")) {
+        return NULL;
+    }
+
+    AVIOContext* io = NULL;
+    if (avio_open2(&io, url, AVIO_FLAG_READ, NULL, NULL) < 0) {
+        return NULL;
+    }
+
+    /* Master playlists are small; read up to 1 MB */
+    int size = 0;
+    int capacity = 64 * 1024;
+    char* text = (char*)av_malloc(capacity + 1);
+    while (text) {
+        int ret = avio_read(io, (unsigned char*)text + size, capacity - size);
+        if (ret <= 0) {
+            break;
+        }
+        size += ret;
+        if (size == capacity) {
+            if (capacity >= 1024 * 1024) {
+                break;
+            }
+            capacity *= 2;
+            char* grown = (char*)av_realloc(text, capacity + 1);
+            if (!grown) {
+                av_freep(&text);
+            }
+            text = grown;
+        }
+    }
+    avio_closep(&io);
+    if (!text) {
+        return NULL;
+    }
+    text[size] = '\0';
+
+    static const char tag[] = "#EXT-X-I-FRAME-STREAM-INF:";
+    char* best = NULL;
+    int64_t best_bandwidth = INT64_MAX;
+
+    for (char* line = text; line && *line; ) {
+        char* end = strchr(line, '\n');
+        if (end) {
+            *end = '\0';
+        }
+
+        if (strncmp(line, tag, sizeof(tag) - 1) == 0) {
+            const char* bandwidth = strstr(line, "BANDWIDTH=");
+            const char* uri = strstr(line, "URI=\"");
+            /* AVERAGE-BANDWIDTH also contains "BANDWIDTH=" */
+            while (bandwidth && bandwidth > line && bandwidth[-1] == '-') {
+                bandwidth = strstr(bandwidth + 1, "BANDWIDTH=");
+            }
+            const char* uri_end = uri ? strchr(uri + 5, '"') : NULL;
+            int64_t value = bandwidth ? strtoll(bandwidth + 10, NULL, 10) : INT64_MAX - 1;
+            if (uri_end && value < best_bandwidth) {
+                char* resolved = resolve_playlist_uri(url, uri + 5, (size_t)(uri_end - uri - 5));
+                if (resolved) {
+                    av_free(best);
+                    best = resolved;
+                    best_bandwidth = value;
+                }
+            }
+        }
+
+        line = end ? end + 1 : NULL;
+    }
+
+    av_free(text);
+    return best;
+}
+
+/* Scale a decoded keyframe into thumbnail index's tile */
+static void write_thumbnail_tile(ThumbnailJob* job, struct SwsContext** sws, AVFrame* frame, int index) {
+    PrismThumbnails* result = job->result;
+
+    *sws = sws_getCachedContext(*sws, frame->width, frame->height, (enum AVPixelFormat)frame->format,
+        result->tile_width, result->tile_height, job->dst_fmt, SWS_BILINEAR, NULL, NULL, NULL);
+    if (!*sws) {
+        return;
+    }
+
+    uint8_t* dst[4] = {
+        result->atlas +
+            (size_t)(index / result->columns) * result->tile_height * result->atlas_stride +
+            (size_t)(index % result->columns) * result->tile_width * 4
+    };
+    int dst_stride[4] = { result->atlas_stride };
+    sws_scale(*sws, (const uint8_t* const*)frame->data, frame->linesize, 0, frame->height, dst, dst_stride);
+}
+
+/* Copy a finished tile (two thumbnails that land on the same keyframe) */
+static void copy_thumbnail_tile(PrismThumbnails* result, int from, int to) {
+    for (int y = 0; y < result->tile_height; y++) {
+        const uint8_t* src = result->atlas +
+            ((size_t)(from / result->columns) * result->tile_height + y) * result->atlas_stride +
+            (size_t)(from % result->columns) * result->tile_width * 4;
+        uint8_t* dst = result->atlas +
+            ((size_t)(to / result->columns) * result->tile_height + y) * result->atlas_stride +
+            (size_t)(to % result->columns) * result->tile_width * 4;
+        memcpy(dst, src, (size_t)result->tile_width * 4);
+    }
+}
+
+/* Decode the first keyframe at or after the current read position.
+ * Returns false at end of stream or on error. */
+static bool decode_thumbnail_keyframe(AVFormatContext* fmt, AVCodecContext* dec, int stream_index,
+    AVPacket* packet, AVFrame* frame, int64_t* key_pts, int64_t last_key_pts) {
+    while (av_read_frame(fmt, packet) >= 0) {
+        if (packet->stream_index != stream_index || !(packet->flags & AV_PKT_FLAG_KEY)) {
+            av_packet_unref(packet);
+            continue;
+        }
+
+        *key_pts = (packet->pts != AV_NOPTS_VALUE) ? packet->pts : packet->dts;
+        if (*key_pts != AV_NOPTS_VALUE && *key_pts == last_key_pts) {
+            /* Same keyframe as the previous thumbnail; the caller copies it */
+            av_packet_unref(packet);
+            return true;
+        }
+
+        int ret = avcodec_send_packet(dec, packet);
+        av_packet_unref(packet);
+        if (ret < 0) {
+            continue;
+        }
+        avcodec_send_packet(dec, NULL);
+        ret = avcodec_receive_frame(dec, frame);
+        avcodec_flush_buffers(dec);
+        if (ret >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static prism_thread_ret_t PRISM_THREAD_CALL thumbnail_thread_func(void* arg) {
+    ThumbnailJob* job = (ThumbnailJob*)arg;
+    PrismThumbnails* result = job->result;
+    AVFormatContext* fmt = NULL;
+    AVCodecContext* dec = NULL;
+    struct SwsContext* sws = NULL;
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    const AVCodec* codec = NULL;
+
+    if (!packet || !frame || open_thumbnail_input(&fmt, job->url) < 0) {
+        goto done;
+    }
+
+    int stream_index = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (stream_index < 0 || !codec) {
+        goto done;
+    }
+    for (unsigned int i = 0; i < fmt->nb_streams; i++) {
+        fmt->streams[i]->discard = ((int)i == stream_index) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+
+    AVStream* stream = fmt->streams[stream_index];
+    dec = avcodec_alloc_context3(codec);
+    if (!dec || avcodec_parameters_to_context(dec, stream->codecpar) < 0) {
+        goto done;
+    }
+
+    /* Parallelism comes from the worker pool; decode only keyframes, at the
+     * smallest lowres level that still covers the tile */
+    dec->thread_count = 1;
+    dec->skip_frame = AVDISCARD_NONKEY;
+    int lowres = 0;
+    while (lowres < codec->max_lowres &&
+           (dec->width >> (lowres + 1)) >= result->tile_width &&
+           (dec->height >> (lowres + 1)) >= result->tile_height) {
+        lowres++;
+    }
+    dec->lowres = lowres;
+    if (avcodec_open2(dec, codec, NULL) < 0) {
+        goto done;
+    }
+
+    double time_base = av_q2d(stream->time_base);
+    int64_t last_key_pts = AV_NOPTS_VALUE;
+    int last_index = -1;
+
+    while (1) {
+        int index = (int)atomic_add(&job->next, 1) - 1;
+        if (index >= result->count) {
+            break;
+        }
+
+        double target = job->duration * (index + 0.5) / result->count;
+        if (av_seek_frame(fmt, -1, (int64_t)(target * AV_TIME_BASE), AVSEEK_FLAG_BACKWARD) < 0) {
+            continue;
+        }
+
+        int64_t key_pts = AV_NOPTS_VALUE;
+        if (!decode_thumbnail_keyframe(fmt, dec, stream_index, packet, frame, &key_pts, last_key_pts)) {
+            continue;
+        }
+
+        if (last_index >= 0 && key_pts != AV_NOPTS_VALUE && key_pts == last_key_pts) {
+            copy_thumbnail_tile(result, last_index, index);
+            result->timestamps[index] = result->timestamps[last_index];
+            continue;
+        }
+
+        write_thumbnail_tile(job, &sws, frame, index);
+        int64_t pts = (frame->best_effort_timestamp != AV_NOPTS_VALUE) ? frame->best_effort_timestamp : key_pts;
+        result->timestamps[index] = (pts != AV_NOPTS_VALUE) ? pts * time_base : target;
+        av_frame_unref(frame);
+
+        last_key_pts = key_pts;
+        last_index = index;
+        atomic_add(&job->decoded, 1);
+    }
+
+done:
+    sws_freeContext(sws);
+    avcodec_free_context(&dec);
+    if (fmt) {
+        avformat_close_input(&fmt);
+    }
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    return (prism_thread_ret_t)0;
+}
+
+PRISM_API PrismThumbnails* prism_thumbnails_generate(const char* url, const PrismThumbnailOptions* options) {
+    if (!url || !options || options->count <= 0 || options->tile_width <= 0 || options->tile_height < 0) {
+        return NULL;
+    }
+
+    int64_t start = av_gettime();
+
+    /* Probe duration and aspect ratio, preferring the I-frame playlist */
+    char* iframe_url = find_iframe_playlist(url);
+    const char* source = iframe_url ? iframe_url : url;
+    AVFormatContext* probe = NULL;
+    if (iframe_url && open_thumbnail_input(&probe, iframe_url) < 0) {
+        prism_log(1, "Thumbnails: I-frame playlist unusable, using %s", url);
+        source = url;
+    }
+    if (!probe && open_thumbnail_input(&probe, source) < 0) {
+        prism_log(0, "Thumbnails: could not open %s", url);
+        av_free(iframe_url);
+        return NULL;
+    }
+
+    int stream_index = av_find_best_stream(probe, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    double duration = (probe->duration != AV_NOPTS_VALUE) ? (double)probe->duration / AV_TIME_BASE : 0.0;
+    int video_width = 0;
+    int video_height = 0;
+    if (stream_index >= 0) {
+        AVStream* stream = probe->streams[stream_index];
+        AVRational sar = av_guess_sample_aspect_ratio(probe, stream, NULL);
+        video_width = stream->codecpar->width;
+        video_height = stream->codecpar->height;
+        if (sar.num > 0 && sar.den > 0) {
+            video_width = (int)av_rescale(video_width, sar.num, sar.den);
+        }
+    }
+    avformat_close_input(&probe);
+
+    if (stream_index < 0 || duration <= 0 || video_width <= 0 || video_height <= 0) {
+        prism_log(0, "Thumbnails: %s has no seekable video", url);
+        av_free(iframe_url);
+        return NULL;
+    }
+
+    PrismThumbnails* result = (PrismThumbnails*)calloc(1, sizeof(PrismThumbnails));
+    if (!result) {
+        av_free(iframe_url);
+        return NULL;
+    }
+    result->count = options->count;
+    result->tile_width = options->tile_width;
+    result->tile_height = options->tile_height > 0 ? options->tile_height :
+        FFMAX(2, (int)((int64_t)options->tile_width * video_height / video_width) & ~1);
+    result->columns = options->columns > 0 ? FFMIN(options->columns, options->count) : 1;
+    while (options->columns <= 0 && result->columns * result->columns < options->count) {
+        result->columns++;
+    }
+    int rows = (options->count + result->columns - 1) / result->columns;
+    result->atlas_width = result->columns * result->tile_width;
+    result->atlas_height = rows * result->tile_height;
+    result->atlas_stride = FFALIGN(result->atlas_width * 4, 32);
+    result->atlas = (uint8_t*)av_mallocz((size_t)result->atlas_stride * result->atlas_height);
+    result->timestamps = (double*)av_malloc_array(options->count, sizeof(double));
+    if (!result->atlas || !result->timestamps) {
+        prism_thumbnails_free(result);
+        av_free(iframe_url);
+        return NULL;
+    }
+    for (int i = 0; i < options->count; i++) {
+        result->timestamps[i] = -1.0;
+    }
+
+    ThumbnailJob job;
+    memset(&job, 0, sizeof(job));
+    job.url = source;
+    job.duration = duration;
+    job.dst_fmt = (options->format == PRISM_PIXEL_FORMAT_BGRA) ? AV_PIX_FMT_BGRA : AV_PIX_FMT_RGBA;
+    job.result = result;
+
+    /* The calling thread is one of the workers */
+    int threads = options->threads > 0 ? options->threads : prism_get_core_budget();
+    threads = FFMAX(1, FFMIN(threads, options->count));
+    prism_thread_t* workers = (prism_thread_t*)calloc(threads, sizeof(prism_thread_t));
+    int started = 0;
+    for (int i = 1; workers && i < threads; i++) {
+        if (thread_create(&workers[started], thumbnail_thread_func, &job)) {
+            started++;
+        }
+    }
+    thumbnail_thread_func(&job);
+
+    /* Workers write to job and the atlas until they return: wait for each
+     * one without a timeout before either goes away */
+    for (int i = 0; i < started; i++) {
+        thread_join(&workers[i]);
+    }
+    free(workers);
+
+    prism_log(1, "Thumbnails: %d tiles (%d keyframes decoded) from %s in %.1f ms, %d threads",
+        result->count, (int)load_acquire(&job.decoded), iframe_url && source == iframe_url ? "I-frame playlist" : "media",
+        (av_gettime() - start) / 1000.0, started + 1);
+
+    av_free(iframe_url);
+    return result;
+}
+
+PRISM_API void prism_thumbnails_free(PrismThumbnails* thumbnails) {
+    if (!thumbnails) {
+        return;
+    }
+    av_free(thumbnails->atlas);
+    av_free(thumbnails->timestamps);
+    free(thumbnails);
+}
@@ -0,0 +1,251 @@
+/*
+ * Prism FFmpeg Native Plugin - Keyframe index
+ *
+ * The cache file is a fixed header followed by the entry array, in native
+ * byte order: the cache lives next to the player that wrote it.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#include "prism_index.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <libavutil/mathematics.h>
+#include <libavutil/mem.h>
+
+#define PRISM_INDEX_MAGIC "PRISMIDX"
+#define PRISM_INDEX_VERSION 1
+
+typedef struct PrismIndexHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t stream_index;
+    uint64_t key;
+    int32_t time_base_num;
+    int32_t time_base_den;
+    int32_t count;
+    int32_t reserved;
+} PrismIndexHeader;
+
+static bool index_append(PrismKeyframeIndex* index, int64_t timestamp, int64_t pos, int size) {
+    if (index->count == index->capacity) {
+        int capacity = index->capacity ? index->capacity * 2 : 1024;
+        PrismIndexEntry* entries = (PrismIndexEntry*)av_realloc_array(index->entries, capacity, sizeof(PrismIndexEntry));
+        if (!entries) {
+            return false;
+        }
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+
+    PrismIndexEntry* entry = &index->entries[index->count++];
+    entry->timestamp = timestamp;
+    entry->pos = pos;
+    entry->size = size;
+    entry->reserved = 0;
+    return true;
+}
+
+int prism_index_build(PrismKeyframeIndex* index, const char* url, int stream_index,
+    const AVIOInterruptCB* interrupt) {
+    AVFormatContext* ctx = avformat_alloc_context();
+    if (!ctx) {
+        return AVERROR(ENOMEM);
+    }
+    if (interrupt) {
+        ctx->interrupt_callback = *interrupt;
+    }
+
+    /* Frees ctx on failure */
+    int ret = avformat_open_input(&ctx, url, NULL, NULL);
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (stream_index < 0 || stream_index >= (int)ctx->nb_streams) {
+        avformat_close_input(&ctx);
+        return AVERROR_STREAM_NOT_FOUND;
+    }
+
+    /* Only the indexed stream's packets are needed */
+    for (unsigned int i = 0; i < ctx->nb_streams; i++) {
+        ctx->streams[i]->discard = ((int)i == stream_index) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+
+    AVStream* stream = ctx->streams[stream_index];
+    index->stream_index = stream_index;
+    index->time_base = stream->time_base;
+    index->count = 0;
+
+    int64_t min_spacing = av_rescale_q(PRISM_INDEX_MIN_SPACING_MS, (AVRational){1, 1000}, stream->time_base);
+    int64_t last = AV_NOPTS_VALUE;
+
+    AVPacket* packet = av_packet_alloc();
+    if (!packet) {
+        avformat_close_input(&ctx);
+        return AVERROR(ENOMEM);
+    }
+
+    while ((ret = av_read_frame(ctx, packet)) >= 0) {
+        if (packet->stream_index == stream_index && (packet->flags & AV_PKT_FLAG_KEY) && packet->pos >= 0) {
+            /* Same timestamps FFmpeg's generic index uses */
+            int64_t timestamp = (packet->dts != AV_NOPTS_VALUE) ? packet->dts : packet->pts;
+            if (timestamp != AV_NOPTS_VALUE && (last == AV_NOPTS_VALUE || timestamp - last >= min_spacing)) {
+                if (!index_append(index, timestamp, packet->pos, packet->size)) {
+                    av_packet_unref(packet);
+                    ret = AVERROR(ENOMEM);
+                    break;
+                }
+                last = timestamp;
+            }
+        }
+        av_packet_unref(packet);
+    }
+
+    av_packet_free(&packet);
+    avformat_close_input(&ctx);
+    return (ret == AVERROR_EOF) ? 0 : ret;
+}
+
+int prism_index_apply(const PrismKeyframeIndex* index, AVFormatContext* ctx) {
+    if (index->stream_index < 0 || index->stream_index >= (int)ctx->nb_streams) {
+        return 0;
+    }
+
+    AVStream* stream = ctx->streams[index->stream_index];
+    if (av_cmp_q(stream->time_base, index->time_base) != 0) {
+        return 0;
+    }
+
+    int added = 0;
+    for (int i = 0; i < index->count; i++) {
+        const PrismIndexEntry* entry = &index->entries[i];
+        if (av_add_index_entry(stream, entry->pos, entry->timestamp, entry->size, 0, AVINDEX_KEYFRAME) >= 0) {
+            added++;
+        }
+    }
+    return added;
+}
+
+bool prism_index_stream_is_indexed(AVStream* stream, int64_t duration) {
+    int count = avformat_index_get_entries_count(stream);
+    if (count < 2 || duration <= 0) {
+        return false;
+    }
+
+    /* Allow for a final keyframe up to ten seconds before the end */
+    const AVIndexEntry* last = avformat_index_get_entry(stream, count - 1);
+    int64_t end = av_rescale_q(last->timestamp, stream->time_base, AV_TIME_BASE_Q);
+    return end >= duration - 10 * (int64_t)AV_TIME_BASE;
+}
+
+/* FNV-1a */
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t prism_index_file_key(const char* url, int64_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = hash_bytes(hash, url, strlen(url));
+    hash = hash_bytes(hash, &size, sizeof(size));
+
+    const char* path = (strncmp(url, "file:", 5) == 0) ? url + 5 : url;
+    int64_t mtime = 0;
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(path, &info) == 0) {
+        mtime = (int64_t)info.st_mtime;
+    }
+#else
+    struct stat info;
+    if (stat(path, &info) == 0) {
+        mtime = (int64_t)info.st_mtime;
+    }
+#endif
+    return hash_bytes(hash, &mtime, sizeof(mtime));
+}
+
+void prism_index_cache_path(char* out, size_t out_size, const char* dir, uint64_t key) {
+    snprintf(out, out_size, "%s/%016llx.pidx", dir, (unsigned long long)key);
+}
+
+bool prism_index_load(PrismKeyframeIndex* index, const char* path, uint64_t key) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    PrismIndexHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, PRISM_INDEX_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == PRISM_INDEX_VERSION &&
+        header.key == key &&
+        header.count > 0 && header.time_base_den > 0;
+
+    PrismIndexEntry* entries = NULL;
+    if (ok) {
+        entries = (PrismIndexEntry*)av_malloc_array(header.count, sizeof(PrismIndexEntry));
+        ok = entries && fread(entries, sizeof(PrismIndexEntry), header.count, file) == (size_t)header.count;
+    }
+    fclose(file);
+
+    if (!ok) {
+        av_free(entries);
+        return false;
+    }
+
+    prism_index_free(index);
+    index->entries = entries;
+    index->count = header.count;
+    index->capacity = header.count;
+    index->stream_index = header.stream_index;
+    index->time_base = (AVRational){header.time_base_num, header.time_base_den};
+    index->key = key;
+    return true;
+}
+
+bool prism_index_save(const PrismKeyframeIndex* index, const char* path) {
+    char temp_path[1100];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    PrismIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PRISM_INDEX_MAGIC, sizeof(header.magic));
+    header.version = PRISM_INDEX_VERSION;
+    header.stream_index = index->stream_index;
+    header.key = index->key;
+    header.time_base_num = index->time_base.num;
+    header.time_base_den = index->time_base.den;
+    header.count = index->count;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(index->entries, sizeof(PrismIndexEntry), index->count, file) == (size_t)index->count;
+    ok = (fclose(file) == 0) && ok;
+
+    /* rename() does not replace an existing file on Windows */
+    remove(path);
+    if (!ok || rename(temp_path, path) != 0) {
+        remove(temp_path);
+        return false;
+    }
+    return true;
+}
+
+void prism_index_free(PrismKeyframeIndex* index) {
+    av_freep(&index->entries);
+    index->count = 0;
+    index->capacity = 0;
+}
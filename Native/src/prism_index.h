@@ -0,0 +1,71 @@
+/*
+ * Prism FFmpeg Native Plugin - Keyframe index
+ *
+ * Builds a timestamp -> byte offset table of one stream's keyframes by
+ * scanning the whole file, merges it into a demuxer's stream index so
+ * av_seek_frame can jump straight to a keyframe, and stores it in an
+ * on-disk cache keyed by file identity.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#ifndef PRISM_INDEX_H
+#define PRISM_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <libavformat/avformat.h>
+
+/* Keyframes closer together than this are not indexed (keeps audio-only
+ * indexes, where every packet is a keyframe, small) */
+#define PRISM_INDEX_MIN_SPACING_MS 500
+
+typedef struct PrismIndexEntry {
+    int64_t timestamp;  /* DTS (PTS if unset) in the stream's time base */
+    int64_t pos;        /* Byte offset of the packet */
+    int32_t size;       /* Packet size in bytes */
+    int32_t reserved;
+} PrismIndexEntry;
+
+typedef struct PrismKeyframeIndex {
+    PrismIndexEntry* entries;
+    int count;
+    int capacity;
+    int stream_index;
+    AVRational time_base;
+    uint64_t key;       /* File identity the index was built for */
+} PrismKeyframeIndex;
+
+/* Scan url from the start and record stream_index's keyframes. Opens its
+ * own demuxer; interrupt (may be NULL) lets the caller cancel the scan.
+ * Returns 0 on success or a negative AVERROR. */
+int prism_index_build(PrismKeyframeIndex* index, const char* url, int stream_index,
+    const AVIOInterruptCB* interrupt);
+
+/* Add the index's entries to the matching stream of ctx as keyframe index
+ * entries. Must run on the thread that owns ctx. Returns the number of
+ * entries added (0 if the stream does not match). */
+int prism_index_apply(const PrismKeyframeIndex* index, AVFormatContext* ctx);
+
+/* True if stream already has container index entries reaching duration
+ * (AV_TIME_BASE units), in which case building an index gains nothing */
+bool prism_index_stream_is_indexed(AVStream* stream, int64_t duration);
+
+/* Identity of a media file: a hash of url, size and, for local files,
+ * modification time */
+uint64_t prism_index_file_key(const char* url, int64_t size);
+
+/* Cache file path for key inside dir */
+void prism_index_cache_path(char* out, size_t out_size, const char* dir, uint64_t key);
+
+/* Load a cached index; fails unless it was saved for key */
+bool prism_index_load(PrismKeyframeIndex* index, const char* path, uint64_t key);
+
+/* Save index (written to a temporary file, then renamed into place) */
+bool prism_index_save(const PrismKeyframeIndex* index, const char* path);
+
+void prism_index_free(PrismKeyframeIndex* index);
+
+#endif /* PRISM_INDEX_H */
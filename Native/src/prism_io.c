@@ -0,0 +1,666 @@
+/*
+ * Prism FFmpeg Native Plugin - Custom I/O
+ *
+ * Read-ahead: the ring holds the byte range [start, end) of the source. The
+ * I/O thread appends at end until it is forward_limit bytes ahead of the
+ * reader, so at least a quarter of the ring always stays behind the read
+ * position for short backward seeks. A seek outside the window empties the
+ * ring and the I/O thread seeks the underlying context; reads in flight at
+ * that moment are discarded (tracked by generation).
+ *
+ * Mapped file: the whole file is mapped read-only and read by memcpy. The
+ * kernel is told the access is sequential and asked to prefetch a window
+ * ahead of the reader. A file truncated while mapped faults on access, the
+ * same trade-off every mmap reader makes.
+ *
+ * Throughput meter: a pass-through context timing each read of the one it
+ * wraps.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#include "prism_io.h"
+#include "prism_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define READ_AHEAD_CHUNK (64 * 1024)
+#define READ_AHEAD_AVIO_BUFFER (32 * 1024)
+#define FILL_RATE_WINDOW_US 250000
+
+#define METER_AVIO_BUFFER (32 * 1024)
+#define MAPPED_AVIO_BUFFER (256 * 1024)
+#define MAPPED_PREFETCH (16 * 1024 * 1024)
+
+struct PrismReadAhead {
+    AVIOContext* inner;         /* Underlying protocol or media cache, used by the I/O thread only */
+    AVIOContext* pb;            /* Handed to the demuxer */
+    int64_t size;               /* Source size, -1 if unknown */
+
+    uint8_t* ring;
+    int64_t capacity;
+    int64_t forward_limit;
+
+    /* Guarded by lock */
+    int64_t start;
+    int64_t end;
+    int64_t read_pos;
+    int64_t seek_to;            /* Pending out-of-window seek for the I/O thread, -1 = none */
+    unsigned int generation;    /* Bumped when the window is thrown away */
+    int error;                  /* Sticky read error (AVERROR_EOF at the end) */
+    int64_t stalls;
+    int64_t bytes_read;
+    double fill_rate;
+
+    volatile int abort;
+
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE data_cond;   /* Bytes appended, error or abort */
+    CONDITION_VARIABLE space_cond;  /* Bytes consumed, seek or abort */
+    HANDLE thread;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t data_cond;
+    pthread_cond_t space_cond;
+    pthread_t thread;
+#endif
+    bool thread_started;
+};
+
+static void ra_lock(PrismReadAhead* ra) {
+#ifdef _WIN32
+    EnterCriticalSection(&ra->lock);
+#else
+    pthread_mutex_lock(&ra->lock);
+#endif
+}
+
+static void ra_unlock(PrismReadAhead* ra) {
+#ifdef _WIN32
+    LeaveCriticalSection(&ra->lock);
+#else
+    pthread_mutex_unlock(&ra->lock);
+#endif
+}
+
+#ifdef _WIN32
+static void ra_wait(PrismReadAhead* ra, CONDITION_VARIABLE* cond) {
+    SleepConditionVariableCS(cond, &ra->lock, INFINITE);
+}
+
+static void ra_signal(CONDITION_VARIABLE* cond) {
+    WakeAllConditionVariable(cond);
+}
+#else
+static void ra_wait(PrismReadAhead* ra, pthread_cond_t* cond) {
+    pthread_cond_wait(cond, &ra->lock);
+}
+
+static void ra_signal(pthread_cond_t* cond) {
+    pthread_cond_broadcast(cond);
+}
+#endif
+
+/* Copy between the ring and linear memory at file offset pos, wrapping */
+static void ring_write(PrismReadAhead* ra, int64_t pos, const uint8_t* src, int size) {
+    int64_t offset = pos % ra->capacity;
+    int first = (int)FFMIN((int64_t)size, ra->capacity - offset);
+    memcpy(ra->ring + offset, src, first);
+    memcpy(ra->ring, src + first, size - first);
+}
+
+static void ring_read(PrismReadAhead* ra, int64_t pos, uint8_t* dst, int size) {
+    int64_t offset = pos % ra->capacity;
+    int first = (int)FFMIN((int64_t)size, ra->capacity - offset);
+    memcpy(dst, ra->ring + offset, first);
+    memcpy(dst + first, ra->ring, size - first);
+}
+
+static int io_interrupt(void* opaque) {
+    return ((PrismReadAhead*)opaque)->abort;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI io_thread_func(void* arg) {
+#else
+static void* io_thread_func(void* arg) {
+#endif
+    PrismReadAhead* ra = (PrismReadAhead*)arg;
+    uint8_t* chunk = (uint8_t*)av_malloc(READ_AHEAD_CHUNK);
+    int64_t window_bytes = 0;
+    int64_t window_us = 0;
+
+    ra_lock(ra);
+    if (!chunk) {
+        ra->error = AVERROR(ENOMEM);
+        ra_signal(&ra->data_cond);
+    }
+
+    while (!ra->abort && chunk) {
+        if (ra->seek_to >= 0) {
+            int64_t target = ra->seek_to;
+            unsigned int generation = ra->generation;
+            ra->seek_to = -1;
+            ra_unlock(ra);
+
+            int64_t ret = avio_seek(ra->inner, target, SEEK_SET);
+
+            ra_lock(ra);
+            if (ret < 0 && generation == ra->generation) {
+                ra->error = (int)ret;
+                ra_signal(&ra->data_cond);
+            }
+            continue;
+        }
+
+        if (ra->error || ra->end - ra->read_pos >= ra->forward_limit) {
+            ra_wait(ra, &ra->space_cond);
+            continue;
+        }
+
+        unsigned int generation = ra->generation;
+        ra_unlock(ra);
+
+        int64_t read_start = av_gettime_relative();
+        int ret = avio_read_partial(ra->inner, chunk, READ_AHEAD_CHUNK);
+        int64_t read_us = av_gettime_relative() - read_start;
+
+        ra_lock(ra);
+        if (generation != ra->generation) {
+            continue;   /* Seeked away while reading */
+        }
+        if (ret == 0) {
+            continue;
+        }
+        if (ret < 0) {
+            ra->error = ret;
+            ra_signal(&ra->data_cond);
+            continue;
+        }
+
+        ring_write(ra, ra->end, chunk, ret);
+        ra->end += ret;
+        if (ra->end - ra->start > ra->capacity) {
+            ra->start = ra->end - ra->capacity;
+        }
+        ra->bytes_read += ret;
+
+        /* Throughput while actually reading, so a full buffer does not
+         * read as a slow connection */
+        window_bytes += ret;
+        window_us += read_us;
+        if (window_us >= FILL_RATE_WINDOW_US) {
+            ra->fill_rate = window_bytes * 1000000.0 / window_us;
+            window_bytes = 0;
+            window_us = 0;
+        }
+
+        ra_signal(&ra->data_cond);
+    }
+
+    ra_unlock(ra);
+    av_free(chunk);
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+static int read_packet(void* opaque, uint8_t* buf, int buf_size) {
+    PrismReadAhead* ra = (PrismReadAhead*)opaque;
+
+    ra_lock(ra);
+    bool waited = false;
+    while (ra->read_pos == ra->end && !ra->error && !ra->abort) {
+        if (!waited) {
+            ra->stalls++;
+            waited = true;
+        }
+        ra_wait(ra, &ra->data_cond);
+    }
+
+    int ret;
+    if (ra->abort) {
+        ret = AVERROR_EXIT;
+    } else if (ra->read_pos < ra->end) {
+        ret = (int)FFMIN((int64_t)buf_size, ra->end - ra->read_pos);
+        ring_read(ra, ra->read_pos, buf, ret);
+        ra->read_pos += ret;
+        ra_signal(&ra->space_cond);
+    } else {
+        ret = ra->error;
+    }
+    ra_unlock(ra);
+    return ret;
+}
+
+static int64_t seek_packet(void* opaque, int64_t offset, int whence) {
+    PrismReadAhead* ra = (PrismReadAhead*)opaque;
+
+    if (whence & AVSEEK_SIZE) {
+        return (ra->size >= 0) ? ra->size : AVERROR(ENOSYS);
+    }
+
+    ra_lock(ra);
+    int64_t target;
+    switch (whence & ~AVSEEK_FORCE) {
+        case SEEK_SET: target = offset; break;
+        case SEEK_CUR: target = ra->read_pos + offset; break;
+        case SEEK_END: target = (ra->size >= 0) ? ra->size + offset : -1; break;
+        default:       target = -1; break;
+    }
+
+    if (target < 0) {
+        target = AVERROR(EINVAL);
+    } else if (target >= ra->start && target <= ra->end) {
+        /* Inside the window: served from memory */
+        ra->read_pos = target;
+        ra_signal(&ra->space_cond);
+    } else if (!(ra->inner->seekable & AVIO_SEEKABLE_NORMAL)) {
+        target = AVERROR(ENOSYS);
+    } else {
+        ra->generation++;
+        ra->start = target;
+        ra->end = target;
+        ra->read_pos = target;
+        ra->seek_to = target;
+        ra->error = 0;
+        ra_signal(&ra->space_cond);
+    }
+    ra_unlock(ra);
+    return target;
+}
+
+int prism_read_ahead_open(PrismReadAhead** out, const char* url, size_t capacity, AVDictionary** options) {
+    *out = NULL;
+
+    PrismReadAhead* ra = (PrismReadAhead*)av_mallocz(sizeof(PrismReadAhead));
+    if (!ra) {
+        return AVERROR(ENOMEM);
+    }
+
+    ra->capacity = (int64_t)FFMAX(capacity, (size_t)PRISM_READ_AHEAD_MIN_SIZE);
+    ra->forward_limit = ra->capacity - ra->capacity / 4;
+    ra->seek_to = -1;
+#ifdef _WIN32
+    InitializeCriticalSection(&ra->lock);
+    InitializeConditionVariable(&ra->data_cond);
+    InitializeConditionVariable(&ra->space_cond);
+#else
+    pthread_mutex_init(&ra->lock, NULL);
+    pthread_cond_init(&ra->data_cond, NULL);
+    pthread_cond_init(&ra->space_cond, NULL);
+#endif
+
+    AVIOInterruptCB interrupt = { io_interrupt, ra };
+    int ret = prism_cache_open(&ra->inner, url, &interrupt, options);
+    if (ret < 0) {
+        prism_read_ahead_close(&ra);
+        return ret;
+    }
+    ra->size = avio_size(ra->inner);
+
+    ra->ring = (uint8_t*)av_malloc(ra->capacity);
+    uint8_t* avio_buffer = (uint8_t*)av_malloc(READ_AHEAD_AVIO_BUFFER);
+    if (ra->ring && avio_buffer) {
+        ra->pb = avio_alloc_context(avio_buffer, READ_AHEAD_AVIO_BUFFER, 0, ra, read_packet, NULL, seek_packet);
+    }
+    if (!ra->pb) {
+        av_free(avio_buffer);
+        prism_read_ahead_close(&ra);
+        return AVERROR(ENOMEM);
+    }
+    ra->pb->seekable = ra->inner->seekable;
+
+#ifdef _WIN32
+    ra->thread = CreateThread(NULL, 0, io_thread_func, ra, 0, NULL);
+    ra->thread_started = (ra->thread != NULL);
+#else
+    ra->thread_started = (pthread_create(&ra->thread, NULL, io_thread_func, ra) == 0);
+#endif
+    if (!ra->thread_started) {
+        prism_read_ahead_close(&ra);
+        return AVERROR(EAGAIN);
+    }
+
+    *out = ra;
+    return 0;
+}
+
+AVIOContext* prism_read_ahead_context(PrismReadAhead* ra) {
+    return ra->pb;
+}
+
+void prism_read_ahead_abort(PrismReadAhead* ra) {
+    ra_lock(ra);
+    ra->abort = 1;
+    ra_signal(&ra->data_cond);
+    ra_signal(&ra->space_cond);
+    ra_unlock(ra);
+}
+
+void prism_read_ahead_get_stats(PrismReadAhead* ra, PrismReadAheadStats* stats) {
+    ra_lock(ra);
+    stats->buffered = ra->end - ra->read_pos;
+    stats->capacity = ra->capacity;
+    stats->fill_rate = ra->fill_rate;
+    stats->stalls = ra->stalls;
+    stats->bytes_read = ra->bytes_read;
+    ra_unlock(ra);
+}
+
+void prism_read_ahead_close(PrismReadAhead** pra) {
+    PrismReadAhead* ra = *pra;
+    if (!ra) {
+        return;
+    }
+    *pra = NULL;
+
+    if (ra->thread_started) {
+        prism_read_ahead_abort(ra);
+#ifdef _WIN32
+        WaitForSingleObject(ra->thread, INFINITE);
+        CloseHandle(ra->thread);
+#else
+        pthread_join(ra->thread, NULL);
+#endif
+    }
+
+    if (ra->pb) {
+        av_freep(&ra->pb->buffer);
+        avio_context_free(&ra->pb);
+    }
+    prism_cache_close(&ra->inner);
+    av_free(ra->ring);
+
+#ifdef _WIN32
+    DeleteCriticalSection(&ra->lock);
+#else
+    pthread_cond_destroy(&ra->space_cond);
+    pthread_cond_destroy(&ra->data_cond);
+    pthread_mutex_destroy(&ra->lock);
+#endif
+    av_free(ra);
+}
+
+/* ============================================================================
+ * Mapped File
+ * ========================================================================== */
+
+struct PrismMappedFile {
+    const uint8_t* data;
+    int64_t size;
+    int64_t pos;
+    int64_t prefetched;         /* Prefetch requested up to here */
+    AVIOContext* pb;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    size_t page_size;
+#endif
+};
+
+/* Ask the kernel to start reading the next window before the demuxer gets
+ * there. Requested half a window early so the reader never catches up. */
+static void mapped_prefetch(PrismMappedFile* file) {
+    if (file->pos + MAPPED_PREFETCH / 2 < file->prefetched || file->prefetched >= file->size) {
+        return;
+    }
+
+    int64_t start = FFMAX(file->pos, file->prefetched);
+    int64_t end = FFMIN(file->pos + MAPPED_PREFETCH, file->size);
+#ifdef _WIN32
+    /* FILE_FLAG_SEQUENTIAL_SCAN makes the cache manager read ahead; touch
+     * nothing here to keep Windows 7 support (no PrefetchVirtualMemory) */
+    (void)start;
+#else
+    int64_t aligned = start - start % (int64_t)file->page_size;
+    madvise((void*)(file->data + aligned), (size_t)(end - aligned), MADV_WILLNEED);
+#endif
+    file->prefetched = end;
+}
+
+static int mapped_read(void* opaque, uint8_t* buf, int buf_size) {
+    PrismMappedFile* file = (PrismMappedFile*)opaque;
+    if (file->pos >= file->size) {
+        return AVERROR_EOF;
+    }
+
+    mapped_prefetch(file);
+
+    int size = (int)FFMIN((int64_t)buf_size, file->size - file->pos);
+    memcpy(buf, file->data + file->pos, size);
+    file->pos += size;
+    return size;
+}
+
+static int64_t mapped_seek(void* opaque, int64_t offset, int whence) {
+    PrismMappedFile* file = (PrismMappedFile*)opaque;
+
+    int64_t target;
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE: return file->size;
+        case SEEK_SET:    target = offset; break;
+        case SEEK_CUR:    target = file->pos + offset; break;
+        case SEEK_END:    target = file->size + offset; break;
+        default:          return AVERROR(EINVAL);
+    }
+    if (target < 0) {
+        return AVERROR(EINVAL);
+    }
+
+    /* A jump restarts prefetching from the new position */
+    if (target < file->pos || target > file->prefetched) {
+        file->prefetched = target;
+    }
+    file->pos = target;
+    return target;
+}
+
+int prism_mapped_file_open(PrismMappedFile** out, const char* url) {
+    *out = NULL;
+
+    const char* path = (strncmp(url, "file:", 5) == 0) ? url + 5 : url;
+
+    PrismMappedFile* file = (PrismMappedFile*)av_mallocz(sizeof(PrismMappedFile));
+    if (!file) {
+        return AVERROR(ENOMEM);
+    }
+
+#ifdef _WIN32
+    wchar_t wide_path[1024];
+    if (!MultiByteToWideChar(CP_UTF8, 0, path, -1, wide_path, 1024)) {
+        av_free(file);
+        return AVERROR(EINVAL);
+    }
+
+    file->file = CreateFileW(wide_path, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    LARGE_INTEGER size;
+    if (file->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file->file, &size)) {
+        prism_mapped_file_close(&file);
+        return AVERROR(ENOENT);
+    }
+    file->size = size.QuadPart;
+    if (file->size <= 0 || (uint64_t)file->size > (uint64_t)SIZE_MAX) {
+        prism_mapped_file_close(&file);
+        return AVERROR(ENOMEM);
+    }
+
+    file->mapping = CreateFileMappingW(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (file->mapping) {
+        file->data = (const uint8_t*)MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        av_free(file);
+        return AVERROR(ENOENT);
+    }
+    file->size = (int64_t)info.st_size;
+    file->page_size = (size_t)sysconf(_SC_PAGESIZE);
+    if (file->size <= 0 || (uint64_t)file->size > (uint64_t)SIZE_MAX) {
+        close(fd);
+        av_free(file);
+        return AVERROR(ENOMEM);
+    }
+
+    /* The page cache drops pages behind a sequential reader sooner and
+     * reads further ahead */
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    void* data = mmap(NULL, (size_t)file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  /* The mapping keeps the file open */
+    if (data != MAP_FAILED) {
+        madvise(data, (size_t)file->size, MADV_SEQUENTIAL);
+        file->data = (const uint8_t*)data;
+    }
+#endif
+    if (!file->data) {
+        prism_mapped_file_close(&file);
+        return AVERROR(ENOMEM);
+    }
+
+    uint8_t* avio_buffer = (uint8_t*)av_malloc(MAPPED_AVIO_BUFFER);
+    if (avio_buffer) {
+        file->pb = avio_alloc_context(avio_buffer, MAPPED_AVIO_BUFFER, 0, file, mapped_read, NULL, mapped_seek);
+    }
+    if (!file->pb) {
+        av_free(avio_buffer);
+        prism_mapped_file_close(&file);
+        return AVERROR(ENOMEM);
+    }
+    file->pb->seekable = AVIO_SEEKABLE_NORMAL;
+
+    *out = file;
+    return 0;
+}
+
+AVIOContext* prism_mapped_file_context(PrismMappedFile* file) {
+    return file->pb;
+}
+
+void prism_mapped_file_close(PrismMappedFile** pfile) {
+    PrismMappedFile* file = *pfile;
+    if (!file) {
+        return;
+    }
+    *pfile = NULL;
+
+    if (file->pb) {
+        av_freep(&file->pb->buffer);
+        avio_context_free(&file->pb);
+    }
+#ifdef _WIN32
+    if (file->data) {
+        UnmapViewOfFile(file->data);
+    }
+    if (file->mapping) {
+        CloseHandle(file->mapping);
+    }
+    if (file->file && file->file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file->file);
+    }
+#else
+    if (file->data) {
+        munmap((void*)file->data, (size_t)file->size);
+    }
+#endif
+    av_free(file);
+}
+
+/* ============================================================================
+ * Throughput Meter
+ * ========================================================================== */
+
+typedef struct MeteredIO {
+    AVIOContext* inner;
+    PrismThroughputMeter* meter;
+} MeteredIO;
+
+static int metered_read(void* opaque, uint8_t* buf, int buf_size) {
+    MeteredIO* io = (MeteredIO*)opaque;
+
+    /* A cached context only reaches the network for missing blocks; reads
+     * served from disk would pass for a very fast link */
+    if (prism_cache_is_cached_context(io->inner)) {
+        int64_t bytes_before, us_before, bytes_after, us_after;
+        prism_cache_network_usage(io->inner, &bytes_before, &us_before);
+        int ret = avio_read_partial(io->inner, buf, buf_size);
+        prism_cache_network_usage(io->inner, &bytes_after, &us_after);
+        io->meter->bytes += bytes_after - bytes_before;
+        io->meter->busy_us += us_after - us_before;
+        return (ret == 0) ? AVERROR_EOF : ret;
+    }
+
+    int64_t start = av_gettime_relative();
+    int ret = avio_read_partial(io->inner, buf, buf_size);
+    io->meter->busy_us += av_gettime_relative() - start;
+    if (ret > 0) {
+        io->meter->bytes += ret;
+    }
+    return (ret == 0) ? AVERROR_EOF : ret;
+}
+
+static int64_t metered_seek(void* opaque, int64_t offset, int whence) {
+    MeteredIO* io = (MeteredIO*)opaque;
+    if (whence & AVSEEK_SIZE) {
+        return avio_size(io->inner);
+    }
+    return avio_seek(io->inner, offset, whence & ~AVSEEK_FORCE);
+}
+
+int prism_meter_wrap(AVIOContext** pb, PrismThroughputMeter* meter) {
+    MeteredIO* io = (MeteredIO*)av_mallocz(sizeof(MeteredIO));
+    uint8_t* buffer = (uint8_t*)av_malloc(METER_AVIO_BUFFER);
+    AVIOContext* wrapper = (io && buffer) ?
+        avio_alloc_context(buffer, METER_AVIO_BUFFER, 0, io, metered_read, NULL, metered_seek) : NULL;
+    if (!wrapper) {
+        av_free(buffer);
+        av_free(io);
+        return AVERROR(ENOMEM);
+    }
+
+    io->inner = *pb;
+    io->meter = meter;
+    wrapper->seekable = io->inner->seekable;
+    *pb = wrapper;
+    return 0;
+}
+
+bool prism_meter_is_wrapper(const AVIOContext* pb) {
+    return pb && pb->read_packet == metered_read;
+}
+
+AVIOContext* prism_meter_unwrap(AVIOContext* pb) {
+    MeteredIO* io = (MeteredIO*)pb->opaque;
+    AVIOContext* inner = io->inner;
+
+    io->meter->closed++;
+    av_freep(&pb->buffer);
+    avio_context_free(&pb);
+    av_free(io);
+    return inner;
+}
@@ -0,0 +1,93 @@
+/*
+ * Prism FFmpeg Native Plugin - Custom I/O
+ *
+ * Read-ahead: wraps a protocol's AVIOContext in a memory ring filled by a
+ * dedicated I/O thread, so network stalls drain the buffer instead of
+ * blocking the demux thread. Seeks inside the buffered window are served
+ * from memory.
+ *
+ * Mapped file: reads a local file through a memory mapping with sequential
+ * access hints, instead of FFmpeg's small read() calls.
+ *
+ * Throughput meter: wraps a context to measure how fast its reads are
+ * served, counting only time spent waiting on the source.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#ifndef PRISM_IO_H
+#define PRISM_IO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <libavformat/avio.h>
+#include <libavutil/dict.h>
+
+/* Smallest ring accepted; the I/O thread reads in 64 KB chunks */
+#define PRISM_READ_AHEAD_MIN_SIZE (1024 * 1024)
+
+/* Ring size players use unless set otherwise */
+#define PRISM_READ_AHEAD_DEFAULT_SIZE (8 * 1024 * 1024)
+
+typedef struct PrismReadAhead PrismReadAhead;
+
+typedef struct PrismReadAheadStats {
+    int64_t buffered;       /* Bytes ahead of the read position */
+    int64_t capacity;       /* Ring size in bytes */
+    double fill_rate;       /* Bytes per second the I/O thread receives while reading */
+    int64_t stalls;         /* Reads that found the buffer empty and had to wait */
+    int64_t bytes_read;     /* Bytes received from the underlying protocol */
+} PrismReadAheadStats;
+
+/* Open url with avio_open2 (options are passed through and consume the
+ * protocol options they match) and start the I/O thread. capacity is
+ * rounded up to PRISM_READ_AHEAD_MIN_SIZE. Returns 0 or a negative AVERROR. */
+int prism_read_ahead_open(PrismReadAhead** out, const char* url, size_t capacity, AVDictionary** options);
+
+/* AVIOContext to install as AVFormatContext.pb (with AVFMT_FLAG_CUSTOM_IO) */
+AVIOContext* prism_read_ahead_context(PrismReadAhead* ra);
+
+/* Make blocked and future reads fail with AVERROR_EXIT, so a reader thread
+ * can be joined before prism_read_ahead_close */
+void prism_read_ahead_abort(PrismReadAhead* ra);
+
+void prism_read_ahead_get_stats(PrismReadAhead* ra, PrismReadAheadStats* stats);
+
+/* Stop the I/O thread and free everything, including the context returned
+ * by prism_read_ahead_context. NULL-safe; sets *ra to NULL. */
+void prism_read_ahead_close(PrismReadAhead** ra);
+
+typedef struct PrismMappedFile PrismMappedFile;
+
+/* Map a local file (path or file: URL, UTF-8) for reading. Fails for empty
+ * files and, on 32-bit hosts, files too large to map. Returns 0 or a
+ * negative AVERROR. */
+int prism_mapped_file_open(PrismMappedFile** out, const char* url);
+
+/* AVIOContext to install as AVFormatContext.pb (with AVFMT_FLAG_CUSTOM_IO) */
+AVIOContext* prism_mapped_file_context(PrismMappedFile* file);
+
+/* Unmap and free everything, including the context. NULL-safe; sets *file to NULL. */
+void prism_mapped_file_close(PrismMappedFile** file);
+
+/* Running totals of metered reads. Not synchronized: wrap only contexts
+ * read on the thread that reads the meter. */
+typedef struct PrismThroughputMeter {
+    int64_t bytes;
+    int64_t busy_us;        /* Time spent inside the wrapped context's reads */
+    unsigned int closed;    /* Wrapped contexts closed so far (segments finished) */
+} PrismThroughputMeter;
+
+/* Replace *pb with a wrapper that reads from it and adds to meter. For a
+ * context from the media cache only blocks fetched from the network count.
+ * On failure *pb is left as it was. Returns 0 or a negative AVERROR. */
+int prism_meter_wrap(AVIOContext** pb, PrismThroughputMeter* meter);
+
+bool prism_meter_is_wrapper(const AVIOContext* pb);
+
+/* Free a wrapper and return the context it wrapped, for the caller to close */
+AVIOContext* prism_meter_unwrap(AVIOContext* pb);
+
+#endif /* PRISM_IO_H */
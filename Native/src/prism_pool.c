@@ -0,0 +1,323 @@
+/*
+ * Prism FFmpeg Native Plugin - Frame buffer pool
+ *
+ * Each registered pool is an AVBufferPool with a custom allocator, plus a
+ * count of its users and of the buffers it has allocated. A pool without
+ * users stays registered, holding its buffers, until the memory held by
+ * unused pools passes POOL_IDLE_LIMIT; the longest unused go first.
+ *
+ * AVBufferPool frees its buffers through frame_buffer_free, which takes
+ * g_pool_lock, so pools are only uninitialized with the lock released.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#include "prism_pool.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <libavutil/mem.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+
+#define POOL_SLOTS 16
+#define POOL_IDLE_LIMIT ((int64_t)256 * 1024 * 1024)
+#define HUGE_PAGE_MIN (4 * 1024 * 1024)
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+typedef struct FramePool {
+    AVBufferPool* pool;
+    size_t size;
+    bool mapped;                /* Buffers are page mappings, huge pages where available */
+    int users;
+    int buffers;                /* Allocated, whether in use or held by the pool */
+    unsigned int released;      /* Order of the last release, for eviction */
+} FramePool;
+
+static FramePool* g_pools[POOL_SLOTS];
+static bool g_huge_pages = false;
+static unsigned int g_release_count = 0;
+#ifdef _WIN32
+static SRWLOCK g_pool_lock = SRWLOCK_INIT;
+#else
+static pthread_mutex_t g_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void lock_pools(void) {
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&g_pool_lock);
+#else
+    pthread_mutex_lock(&g_pool_lock);
+#endif
+}
+
+static void unlock_pools(void) {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(&g_pool_lock);
+#else
+    pthread_mutex_unlock(&g_pool_lock);
+#endif
+}
+
+/* ============================================================================
+ * Allocation
+ * ========================================================================== */
+
+#ifdef _WIN32
+
+static uint8_t* map_buffer(size_t size) {
+    /* Large pages need SeLockMemoryPrivilege; without it this fails at once */
+    SIZE_T large_page = GetLargePageMinimum();
+    if (large_page > 0) {
+        SIZE_T length = (size + large_page - 1) / large_page * large_page;
+        void* data = VirtualAlloc(NULL, length, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (data) {
+            return (uint8_t*)data;
+        }
+    }
+    return (uint8_t*)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+static void unmap_buffer(uint8_t* data, size_t size) {
+    VirtualFree(data, 0, MEM_RELEASE);
+}
+
+static uint8_t* alloc_buffer(size_t size) {
+    return (uint8_t*)_aligned_malloc(size, PRISM_FRAME_ALIGN);
+}
+
+static void free_buffer(uint8_t* data) {
+    _aligned_free(data);
+}
+
+#else
+
+static size_t mapped_length(size_t size) {
+    return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+static uint8_t* map_buffer(size_t size) {
+    size_t length = mapped_length(size);
+
+#ifdef MAP_HUGETLB
+    /* Reserved huge pages (vm.nr_hugepages); fails at once when there are none */
+    void* data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data != MAP_FAILED) {
+        return (uint8_t*)data;
+    }
+#endif
+
+    /* Map one huge page more and trim to a huge page boundary, so transparent
+     * huge pages can back the whole buffer */
+    uint8_t* base = (uint8_t*)mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((void*)base == MAP_FAILED) {
+        return NULL;
+    }
+    uint8_t* aligned = (uint8_t*)(((uintptr_t)base + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if (aligned > base) {
+        munmap(base, (size_t)(aligned - base));
+    }
+    size_t tail = (size_t)(base + length + HUGE_PAGE_SIZE - (aligned + length));
+    if (tail > 0) {
+        munmap(aligned + length, tail);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+
+static void unmap_buffer(uint8_t* data, size_t size) {
+    munmap(data, mapped_length(size));
+}
+
+static uint8_t* alloc_buffer(size_t size) {
+    void* data = NULL;
+    return posix_memalign(&data, PRISM_FRAME_ALIGN, size) == 0 ? (uint8_t*)data : NULL;
+}
+
+static void free_buffer(uint8_t* data) {
+    free(data);
+}
+
+#endif
+
+static void frame_buffer_free(void* opaque, uint8_t* data) {
+    FramePool* pool = (FramePool*)opaque;
+    if (pool->mapped) {
+        unmap_buffer(data, pool->size);
+    } else {
+        free_buffer(data);
+    }
+
+    lock_pools();
+    pool->buffers--;
+    unlock_pools();
+}
+
+static AVBufferRef* frame_buffer_alloc(void* opaque, size_t size) {
+    FramePool* pool = (FramePool*)opaque;
+    uint8_t* data = pool->mapped ? map_buffer(size) : alloc_buffer(size);
+    if (!data) {
+        return NULL;
+    }
+
+    AVBufferRef* buf = av_buffer_create(data, size, frame_buffer_free, pool, 0);
+    if (!buf) {
+        if (pool->mapped) {
+            unmap_buffer(data, size);
+        } else {
+            free_buffer(data);
+        }
+        return NULL;
+    }
+
+    lock_pools();
+    pool->buffers++;
+    unlock_pools();
+    return buf;
+}
+
+/* Called by FFmpeg once the pool is uninitialized and every buffer freed */
+static void frame_pool_free(void* opaque) {
+    av_free(opaque);
+}
+
+/* ============================================================================
+ * Registry
+ * ========================================================================== */
+
+/* Take unused pools out of the registry, longest unused first, until the
+ * memory they hold is within limit (-1 takes them all). Returns how many
+ * were put in out, to be uninitialized without the lock. (g_pool_lock held) */
+static int evict_unused(int64_t limit, AVBufferPool** out) {
+    int count = 0;
+
+    while (1) {
+        int64_t held = 0;
+        int oldest = -1;
+        for (int i = 0; i < POOL_SLOTS; i++) {
+            FramePool* pool = g_pools[i];
+            if (!pool || pool->users > 0) {
+                continue;
+            }
+            held += (int64_t)pool->buffers * (int64_t)pool->size;
+            if (oldest < 0 || (int)(pool->released - g_pools[oldest]->released) < 0) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0 || held <= limit) {
+            return count;
+        }
+        out[count++] = g_pools[oldest]->pool;
+        g_pools[oldest] = NULL;
+    }
+}
+
+static void uninit_pools(AVBufferPool** pools, int count) {
+    for (int i = 0; i < count; i++) {
+        av_buffer_pool_uninit(&pools[i]);
+    }
+}
+
+void prism_frame_pool_set_huge_pages(bool enabled) {
+    lock_pools();
+    g_huge_pages = enabled;
+    unlock_pools();
+}
+
+AVBufferPool* prism_frame_pool_get(size_t size) {
+    AVBufferPool* evicted[POOL_SLOTS];
+    int evicted_count = 0;
+    AVBufferPool* result = NULL;
+
+    lock_pools();
+    int free_slot = -1;
+    for (int i = 0; i < POOL_SLOTS && !result; i++) {
+        if (g_pools[i] && g_pools[i]->size == size) {
+            g_pools[i]->users++;
+            result = g_pools[i]->pool;
+        } else if (!g_pools[i] && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+
+    if (!result) {
+        /* Registry full: make room by dropping every unused pool */
+        if (free_slot < 0) {
+            evicted_count = evict_unused(-1, evicted);
+            for (int i = 0; i < POOL_SLOTS && free_slot < 0; i++) {
+                if (!g_pools[i]) {
+                    free_slot = i;
+                }
+            }
+        }
+
+        FramePool* pool = (FramePool*)av_mallocz(sizeof(FramePool));
+        if (pool) {
+            pool->size = size;
+            pool->mapped = g_huge_pages && size >= HUGE_PAGE_MIN;
+            pool->users = 1;
+            pool->pool = av_buffer_pool_init2(size, pool, frame_buffer_alloc, frame_pool_free);
+            if (!pool->pool) {
+                av_free(pool);
+            } else {
+                /* Without a slot the pool is private and freed on release */
+                if (free_slot >= 0) {
+                    g_pools[free_slot] = pool;
+                }
+                result = pool->pool;
+            }
+        }
+    }
+    unlock_pools();
+
+    uninit_pools(evicted, evicted_count);
+    return result;
+}
+
+void prism_frame_pool_release(AVBufferPool** pool) {
+    if (!pool || !*pool) {
+        return;
+    }
+
+    AVBufferPool* evicted[POOL_SLOTS + 1];
+    int evicted_count = 0;
+
+    lock_pools();
+    bool registered = false;
+    for (int i = 0; i < POOL_SLOTS; i++) {
+        if (g_pools[i] && g_pools[i]->pool == *pool) {
+            g_pools[i]->users--;
+            g_pools[i]->released = ++g_release_count;
+            registered = true;
+            break;
+        }
+    }
+    if (!registered) {
+        evicted[evicted_count++] = *pool;
+    }
+    evicted_count += evict_unused(POOL_IDLE_LIMIT, evicted + evicted_count);
+    unlock_pools();
+
+    uninit_pools(evicted, evicted_count);
+    *pool = NULL;
+}
+
+void prism_frame_pool_clear(void) {
+    AVBufferPool* evicted[POOL_SLOTS];
+
+    lock_pools();
+    int evicted_count = evict_unused(-1, evicted);
+    unlock_pools();
+
+    uninit_pools(evicted, evicted_count);
+}
@@ -0,0 +1,44 @@
+/*
+ * Prism FFmpeg Native Plugin - Frame buffer pool
+ *
+ * Converted video frames are allocated from pools shared by all players
+ * and kept across opens. Pools are found by buffer size, which follows
+ * from the frame geometry and output format, so a second player or a
+ * reopen at the same size reuses buffers that are already allocated and
+ * faulted in. Buffers start on a PRISM_FRAME_ALIGN boundary; laid out with
+ * PRISM_FRAME_ALIGN strides, every row does too. Large buffers can be
+ * backed by huge pages.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#ifndef PRISM_POOL_H
+#define PRISM_POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <libavutil/buffer.h>
+
+/* Buffer and row alignment (cache line, widest SIMD store) */
+#define PRISM_FRAME_ALIGN 64
+
+/* Back buffers of 4 MB and more (1080p RGBA and up) with huge pages:
+ * MAP_HUGETLB when pages are reserved, else transparent huge pages on
+ * Linux, large pages on Windows when the process may lock memory. Applies
+ * to pools created afterwards. */
+void prism_frame_pool_set_huge_pages(bool enabled);
+
+/* Pool of size-byte buffers, shared with every other user of that size.
+ * Release with prism_frame_pool_release. Returns NULL on failure. */
+AVBufferPool* prism_frame_pool_get(size_t size);
+
+/* Stop using a pool from prism_frame_pool_get. Buffers still referenced
+ * stay valid. Unused pools are kept for reuse while the memory they hold
+ * is under a limit. NULL-safe; sets *pool to NULL. */
+void prism_frame_pool_release(AVBufferPool** pool);
+
+/* Free every unused pool */
+void prism_frame_pool_clear(void);
+
+#endif /* PRISM_POOL_H */
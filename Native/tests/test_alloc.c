@@ -0,0 +1,393 @@
+/*
+ * Prism FFmpeg Native Plugin - Steady-state allocation test
+ *
+ * Plays a short clip in real time, driven the way Unity drives a player,
+ * and counts the heap allocations the plugin makes once playback has
+ * warmed up. The plugin sources are linked into this executable with GNU
+ * ld's --wrap, so every allocation call made by plugin code goes through
+ * the counters below; allocations inside FFmpeg's own libraries (packet
+ * and frame references) are FFmpeg's business and not counted. Any
+ * allocation per frame after preroll fails the test.
+ *
+ * Usage: test_alloc [clip]. Without a clip, a 6 second MPEG-4 + MP2
+ * Matroska clip is encoded first.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#include "prism_ffmpeg.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+#include <libavutil/mem.h>
+
+#define CLIP_PATH "prism_alloc_test.mkv"
+#define CLIP_SECONDS 6
+#define CLIP_WIDTH 320
+#define CLIP_HEIGHT 240
+#define CLIP_FPS 25
+#define CLIP_SAMPLE_RATE 48000
+
+#define TICK_US 10000           /* One Unity frame */
+#define WARMUP_SECONDS 1.5      /* Preroll, pool and ring warm-up before counting */
+#define MEASURE_SECONDS 3.0
+#define TIMEOUT_SECONDS 15.0
+
+/* ============================================================================
+ * Allocation Counters
+ * ========================================================================== */
+
+typedef enum Allocator {
+    ALLOC_MALLOC, ALLOC_CALLOC, ALLOC_REALLOC, ALLOC_POSIX_MEMALIGN,
+    ALLOC_AV_MALLOC, ALLOC_AV_MALLOCZ, ALLOC_AV_CALLOC, ALLOC_AV_MALLOC_ARRAY,
+    ALLOC_AV_REALLOC, ALLOC_AV_REALLOC_ARRAY, ALLOC_AV_FAST_MALLOC, ALLOC_AV_STRDUP,
+    ALLOC_AV_FRAME_ALLOC, ALLOC_AV_PACKET_ALLOC, ALLOC_AV_BUFFER_ALLOC, ALLOC_AV_BUFFER_ALLOCZ,
+    ALLOC_COUNT
+} Allocator;
+
+static const char* const g_allocator_names[ALLOC_COUNT] = {
+    "malloc", "calloc", "realloc", "posix_memalign",
+    "av_malloc", "av_mallocz", "av_calloc", "av_malloc_array",
+    "av_realloc", "av_realloc_array", "av_fast_malloc", "av_strdup",
+    "av_frame_alloc", "av_packet_alloc", "av_buffer_alloc", "av_buffer_allocz"
+};
+
+static atomic_bool g_counting = false;
+static atomic_int g_allocations[ALLOC_COUNT];
+
+static void count_allocation(Allocator allocator) {
+    if (atomic_load(&g_counting)) {
+        atomic_fetch_add(&g_allocations[allocator], 1);
+    }
+}
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+int __real_posix_memalign(void** ptr, size_t alignment, size_t size);
+void* __real_av_malloc(size_t size);
+void* __real_av_mallocz(size_t size);
+void* __real_av_calloc(size_t count, size_t size);
+void* __real_av_malloc_array(size_t count, size_t size);
+void* __real_av_realloc(void* ptr, size_t size);
+void* __real_av_realloc_array(void* ptr, size_t count, size_t size);
+void __real_av_fast_malloc(void* ptr, unsigned int* size, size_t min_size);
+char* __real_av_strdup(const char* s);
+AVFrame* __real_av_frame_alloc(void);
+AVPacket* __real_av_packet_alloc(void);
+AVBufferRef* __real_av_buffer_alloc(size_t size);
+AVBufferRef* __real_av_buffer_allocz(size_t size);
+
+void* __wrap_malloc(size_t size) {
+    count_allocation(ALLOC_MALLOC);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    count_allocation(ALLOC_CALLOC);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    count_allocation(ALLOC_REALLOC);
+    return __real_realloc(ptr, size);
+}
+
+int __wrap_posix_memalign(void** ptr, size_t alignment, size_t size) {
+    count_allocation(ALLOC_POSIX_MEMALIGN);
+    return __real_posix_memalign(ptr, alignment, size);
+}
+
+void* __wrap_av_malloc(size_t size) {
+    count_allocation(ALLOC_AV_MALLOC);
+    return __real_av_malloc(size);
+}
+
+void* __wrap_av_mallocz(size_t size) {
+    count_allocation(ALLOC_AV_MALLOCZ);
+    return __real_av_mallocz(size);
+}
+
+void* __wrap_av_calloc(size_t count, size_t size) {
+    count_allocation(ALLOC_AV_CALLOC);
+    return __real_av_calloc(count, size);
+}
+
+void* __wrap_av_malloc_array(size_t count, size_t size) {
+    count_allocation(ALLOC_AV_MALLOC_ARRAY);
+    return __real_av_malloc_array(count, size);
+}
+
+void* __wrap_av_realloc(void* ptr, size_t size) {
+    count_allocation(ALLOC_AV_REALLOC);
+    return __real_av_realloc(ptr, size);
+}
+
+void* __wrap_av_realloc_array(void* ptr, size_t count, size_t size) {
+    count_allocation(ALLOC_AV_REALLOC_ARRAY);
+    return __real_av_realloc_array(ptr, count, size);
+}
+
+/* Only a call that has to grow the buffer allocates */
+void __wrap_av_fast_malloc(void* ptr, unsigned int* size, size_t min_size) {
+    if (min_size > *size) {
+        count_allocation(ALLOC_AV_FAST_MALLOC);
+    }
+    __real_av_fast_malloc(ptr, size, min_size);
+}
+
+char* __wrap_av_strdup(const char* s) {
+    count_allocation(ALLOC_AV_STRDUP);
+    return __real_av_strdup(s);
+}
+
+AVFrame* __wrap_av_frame_alloc(void) {
+    count_allocation(ALLOC_AV_FRAME_ALLOC);
+    return __real_av_frame_alloc();
+}
+
+AVPacket* __wrap_av_packet_alloc(void) {
+    count_allocation(ALLOC_AV_PACKET_ALLOC);
+    return __real_av_packet_alloc();
+}
+
+AVBufferRef* __wrap_av_buffer_alloc(size_t size) {
+    count_allocation(ALLOC_AV_BUFFER_ALLOC);
+    return __real_av_buffer_alloc(size);
+}
+
+AVBufferRef* __wrap_av_buffer_allocz(size_t size) {
+    count_allocation(ALLOC_AV_BUFFER_ALLOCZ);
+    return __real_av_buffer_allocz(size);
+}
+
+static int total_allocations(void) {
+    int total = 0;
+    for (int i = 0; i < ALLOC_COUNT; i++) {
+        total += atomic_load(&g_allocations[i]);
+    }
+    return total;
+}
+
+/* ============================================================================
+ * Test Clip
+ * ========================================================================== */
+
+static bool encode(AVFormatContext* output, AVCodecContext* codec, AVStream* stream, AVFrame* frame, AVPacket* packet) {
+    if (avcodec_send_frame(codec, frame) < 0) {
+        return false;
+    }
+    while (avcodec_receive_packet(codec, packet) >= 0) {
+        av_packet_rescale_ts(packet, codec->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        if (av_interleaved_write_frame(output, packet) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static AVCodecContext* open_encoder(AVFormatContext* output, enum AVCodecID id, AVStream** stream) {
+    const AVCodec* encoder = avcodec_find_encoder(id);
+    AVCodecContext* codec = encoder ? avcodec_alloc_context3(encoder) : NULL;
+    if (!codec) {
+        return NULL;
+    }
+
+    if (id == AV_CODEC_ID_MPEG4) {
+        codec->width = CLIP_WIDTH;
+        codec->height = CLIP_HEIGHT;
+        codec->pix_fmt = AV_PIX_FMT_YUV420P;
+        codec->time_base = (AVRational){ 1, CLIP_FPS };
+        codec->framerate = (AVRational){ CLIP_FPS, 1 };
+        codec->gop_size = CLIP_FPS;
+        codec->bit_rate = 1000000;
+    } else {
+        AVChannelLayout stereo = AV_CHANNEL_LAYOUT_STEREO;
+        av_channel_layout_copy(&codec->ch_layout, &stereo);
+        codec->sample_fmt = AV_SAMPLE_FMT_S16;
+        codec->sample_rate = CLIP_SAMPLE_RATE;
+        codec->time_base = (AVRational){ 1, CLIP_SAMPLE_RATE };
+        codec->bit_rate = 192000;
+    }
+    if (output->oformat->flags & AVFMT_GLOBALHEADER) {
+        codec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    *stream = avformat_new_stream(output, NULL);
+    if (!*stream || avcodec_open2(codec, encoder, NULL) < 0 ||
+        avcodec_parameters_from_context((*stream)->codecpar, codec) < 0) {
+        avcodec_free_context(&codec);
+        return NULL;
+    }
+    (*stream)->time_base = codec->time_base;
+    return codec;
+}
+
+/* Moving gradients and a 440 Hz tone */
+static bool write_clip(const char* path) {
+    AVFormatContext* output = NULL;
+    if (avformat_alloc_output_context2(&output, NULL, "matroska", path) < 0) {
+        return false;
+    }
+
+    AVStream* video_stream = NULL;
+    AVStream* audio_stream = NULL;
+    AVCodecContext* video = open_encoder(output, AV_CODEC_ID_MPEG4, &video_stream);
+    AVCodecContext* audio = video ? open_encoder(output, AV_CODEC_ID_MP2, &audio_stream) : NULL;
+    AVFrame* picture = av_frame_alloc();
+    AVFrame* samples = av_frame_alloc();
+    AVPacket* packet = av_packet_alloc();
+    bool ok = audio && picture && samples && packet &&
+        avio_open(&output->pb, path, AVIO_FLAG_WRITE) >= 0;
+
+    if (ok) {
+        picture->format = video->pix_fmt;
+        picture->width = video->width;
+        picture->height = video->height;
+        samples->format = audio->sample_fmt;
+        samples->sample_rate = audio->sample_rate;
+        samples->nb_samples = audio->frame_size;
+        ok = av_channel_layout_copy(&samples->ch_layout, &audio->ch_layout) >= 0 &&
+            av_frame_get_buffer(picture, 0) >= 0 && av_frame_get_buffer(samples, 0) >= 0 &&
+            avformat_write_header(output, NULL) >= 0;
+    }
+
+    int64_t sample_pts = 0;
+    for (int i = 0; ok && i < CLIP_SECONDS * CLIP_FPS; i++) {
+        ok = av_frame_make_writable(picture) >= 0;
+        for (int y = 0; ok && y < CLIP_HEIGHT; y++) {
+            for (int x = 0; x < CLIP_WIDTH; x++) {
+                picture->data[0][y * picture->linesize[0] + x] = (uint8_t)(x + y + i * 3);
+            }
+        }
+        for (int y = 0; ok && y < CLIP_HEIGHT / 2; y++) {
+            for (int x = 0; x < CLIP_WIDTH / 2; x++) {
+                picture->data[1][y * picture->linesize[1] + x] = (uint8_t)(128 + y + i * 2);
+                picture->data[2][y * picture->linesize[2] + x] = (uint8_t)(64 + x + i * 5);
+            }
+        }
+        picture->pts = i;
+        ok = ok && encode(output, video, video_stream, picture, packet);
+
+        /* Audio up to the end of this video frame */
+        while (ok && sample_pts * CLIP_FPS < (int64_t)(i + 1) * CLIP_SAMPLE_RATE) {
+            ok = av_frame_make_writable(samples) >= 0;
+            int16_t* data = (int16_t*)samples->data[0];
+            for (int s = 0; ok && s < samples->nb_samples; s++) {
+                int16_t value = (int16_t)(8000.0 * sin(2.0 * M_PI * 440.0 * (double)(sample_pts + s) / CLIP_SAMPLE_RATE));
+                data[s * 2] = value;
+                data[s * 2 + 1] = value;
+            }
+            samples->pts = sample_pts;
+            sample_pts += samples->nb_samples;
+            ok = ok && encode(output, audio, audio_stream, samples, packet);
+        }
+    }
+
+    ok = ok && encode(output, video, video_stream, NULL, packet) &&
+        encode(output, audio, audio_stream, NULL, packet) && av_write_trailer(output) >= 0;
+
+    av_packet_free(&packet);
+    av_frame_free(&samples);
+    av_frame_free(&picture);
+    avcodec_free_context(&audio);
+    avcodec_free_context(&video);
+    avio_closep(&output->pb);
+    avformat_free_context(output);
+    return ok;
+}
+
+/* ============================================================================
+ * Playback
+ * ========================================================================== */
+
+/* One Unity frame: update, take the video frame, pull the audio the tick played */
+static int tick(PrismPlayer* player, float* audio, int audio_capacity) {
+    int decoded = prism_player_update(player, TICK_US / 1000000.0);
+    int width, height, stride;
+    prism_player_get_video_frame(player, &width, &height, &stride);
+
+    int wanted = prism_player_get_audio_sample_rate(player) * prism_player_get_audio_channels(player) *
+        TICK_US / 1000000;
+    prism_player_get_audio_samples(player, audio, wanted < audio_capacity ? wanted : audio_capacity);
+
+    usleep(TICK_US);
+    return decoded > 0 ? decoded : 0;
+}
+
+int main(int argc, char** argv) {
+    const char* clip = argc > 1 ? argv[1] : CLIP_PATH;
+    if (argc <= 1 && !write_clip(clip)) {
+        fprintf(stderr, "FAIL could not encode %s\n", clip);
+        return 1;
+    }
+
+    static float audio[8192];
+    prism_init();
+    PrismPlayer* player = prism_player_create();
+    if (!player) {
+        fprintf(stderr, "FAIL could not create a player\n");
+        prism_shutdown();
+        return 1;
+    }
+
+    /* The background keyframe index is a one-off job, not part of the frame loop */
+    prism_player_set_keyframe_index(player, false);
+
+    if (prism_player_open(player, clip) != PRISM_OK || prism_player_play(player) != PRISM_OK) {
+        fprintf(stderr, "FAIL could not play %s: %s\n", clip, prism_player_get_error_message(player));
+        prism_player_destroy(player);
+        prism_shutdown();
+        return 1;
+    }
+
+    int ticks = 0;
+    int max_ticks = (int)(TIMEOUT_SECONDS * 1000000 / TICK_US);
+    while (ticks < max_ticks && prism_player_get_position(player) < WARMUP_SECONDS) {
+        tick(player, audio, (int)(sizeof(audio) / sizeof(audio[0])));
+        ticks++;
+    }
+
+    int frames = 0;
+    double measure_start = prism_player_get_position(player);
+    atomic_store(&g_counting, true);
+    while (ticks < max_ticks && prism_player_get_position(player) - measure_start < MEASURE_SECONDS &&
+           prism_player_get_state(player) == PRISM_STATE_PLAYING) {
+        frames += tick(player, audio, (int)(sizeof(audio) / sizeof(audio[0])));
+        ticks++;
+    }
+    atomic_store(&g_counting, false);
+    double measured = prism_player_get_position(player) - measure_start;
+
+    prism_player_destroy(player);
+    prism_shutdown();
+
+    int allocations = total_allocations();
+    printf("%d frames in %.2f s of playback, %d allocations\n", frames, measured, allocations);
+    for (int i = 0; i < ALLOC_COUNT; i++) {
+        int calls = atomic_load(&g_allocations[i]);
+        if (calls > 0) {
+            printf("  %s: %d\n", g_allocator_names[i], calls);
+        }
+    }
+
+    if (frames == 0 || measured < MEASURE_SECONDS * 0.5) {
+        fprintf(stderr, "FAIL playback did not progress\n");
+        return 1;
+    }
+    if (allocations > 0) {
+        fprintf(stderr, "FAIL %.2f allocations per frame after preroll\n", (double)allocations / frames);
+        return 1;
+    }
+    return 0;
+}
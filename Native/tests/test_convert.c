@@ -0,0 +1,235 @@
+/*
+ * Prism FFmpeg Native Plugin - Conversion kernel tests
+ *
+ * Runs every SIMD kernel the host supports on random 4:2:0 and NV12 frames
+ * of odd and even widths, so each vector loop and tail length is covered.
+ * Output must be bit-exact with prism_yuv_row_c for any samples, and within
+ * 1 of swscale for samples in the nominal range, for BT.601 limited
+ * (YUV420P, NV12) and full (YUVJ420P) range. swscale is set up for the
+ * conversion the kernels implement: chroma replicated, not interpolated,
+ * and accurate rounding. (Its default table-based path is up to 3 off.)
+ *
+ * MIT License - see LICENSE file
+ */
+
+#include "prism_convert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libavutil/cpu.h>
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+
+typedef struct KernelIsa {
+    int cpu_flag;
+    const char* name;
+} KernelIsa;
+
+static const KernelIsa g_isas[] = {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    { AV_CPU_FLAG_SSE4, "sse4.1" },
+    { AV_CPU_FLAG_AVX2, "avx2" },
+    { AV_CPU_FLAG_AVX512, "avx512" },
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    { AV_CPU_FLAG_NEON, "neon" },
+#endif
+};
+
+static const enum AVPixelFormat g_src_formats[] = {
+    AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_NV12
+};
+
+static const enum AVPixelFormat g_dst_formats[] = {
+    AV_PIX_FMT_RGBA, AV_PIX_FMT_BGRA
+};
+
+/* Every tail length of the 16-, 32- and 64-pixel loops, odd widths included */
+static const int g_widths[] = {
+    2, 3, 7, 8, 9, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 79, 95, 96, 97,
+    127, 128, 129, 191, 255, 257, 641, 1279, 1920
+};
+
+static int g_failures = 0;
+
+static uint32_t g_rng = 0x2545F491u;
+
+static uint8_t random_byte(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return (uint8_t)(g_rng >> 24);
+}
+
+/* swscale places chroma by the ratio of the plane sizes, so it replicates
+ * each chroma sample over 2x2 pixels, as the kernels do, only at even
+ * sizes. Buffers are allocated for the size rounded up to even, which is
+ * what swscale converts; odd sizes compare the part inside the frame. */
+static int even(int size) {
+    return (size + 1) & ~1;
+}
+
+static AVFrame* alloc_frame(enum AVPixelFormat format, int width, int height) {
+    AVFrame* frame = av_frame_alloc();
+    if (!frame) {
+        return NULL;
+    }
+    frame->format = format;
+    frame->width = even(width);
+    frame->height = even(height);
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        return NULL;
+    }
+    frame->width = width;
+    frame->height = height;
+    return frame;
+}
+
+static uint8_t random_sample(int min, int max) {
+    return (uint8_t)(min + random_byte() % (max - min + 1));
+}
+
+/* Fill every plane, padding included, with random samples: any value, or
+ * only values in the format's nominal range (swscale does not clamp
+ * limited range input beyond it) */
+static void fill_random(AVFrame* frame, bool nominal) {
+    bool limited = nominal && frame->format != AV_PIX_FMT_YUVJ420P;
+    int planes = frame->format == AV_PIX_FMT_NV12 ? 2 : 3;
+    for (int p = 0; p < planes; p++) {
+        int rows = p == 0 ? even(frame->height) : even(frame->height) / 2;
+        int min = limited ? 16 : 0;
+        int max = limited ? (p == 0 ? 235 : 240) : 255;
+        for (int i = 0; i < rows * frame->linesize[p]; i++) {
+            frame->data[p][i] = random_sample(min, max);
+        }
+    }
+}
+
+static void report(const char* isa, enum AVPixelFormat src, enum AVPixelFormat dst, int width, int height,
+    const char* what, int row, int column) {
+    fprintf(stderr, "FAIL %s src=%d dst=%d %dx%d: %s at row %d, byte %d\n",
+        isa, (int)src, (int)dst, width, height, what, row, column);
+    g_failures++;
+}
+
+/* Compare row by row against prism_yuv_row_c; returns false on the first mismatch */
+static bool check_reference(const PrismYuvKernel* kernel, const AVFrame* src, const AVFrame* out,
+    uint8_t* expected, const char* isa) {
+    int uv_step = kernel->nv12 ? 2 : 1;
+
+    for (int row = 0; row < src->height; row++) {
+        const uint8_t* y = src->data[0] + (ptrdiff_t)row * src->linesize[0];
+        const uint8_t* u = src->data[1] + (ptrdiff_t)(row >> 1) * src->linesize[1];
+        const uint8_t* v = kernel->nv12 ? u + 1 : src->data[2] + (ptrdiff_t)(row >> 1) * src->linesize[2];
+        prism_yuv_row_c(y, u, v, uv_step, expected, src->width, &kernel->coeffs, kernel->bgra);
+
+        const uint8_t* actual = out->data[0] + (ptrdiff_t)row * out->linesize[0];
+        for (int i = 0; i < src->width * 4; i++) {
+            if (actual[i] != expected[i]) {
+                report(isa, kernel->src_format, (enum AVPixelFormat)out->format, src->width, src->height,
+                    "differs from prism_yuv_row_c", row, i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Compare against swscale; returns false on the first difference over 1 */
+static bool check_swscale(const AVFrame* src, const AVFrame* out, AVFrame* scaled, const char* isa) {
+    int width = even(src->width);
+    int height = even(src->height);
+    struct SwsContext* sws = sws_getContext(width, height, (enum AVPixelFormat)src->format,
+        width, height, (enum AVPixelFormat)scaled->format,
+        SWS_POINT | SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND, NULL, NULL, NULL);
+    if (!sws) {
+        report(isa, (enum AVPixelFormat)src->format, (enum AVPixelFormat)out->format, src->width, src->height,
+            "no swscale context", 0, 0);
+        return false;
+    }
+    sws_scale(sws, (const uint8_t* const*)src->data, src->linesize, 0, height,
+        scaled->data, scaled->linesize);
+    sws_freeContext(sws);
+
+    for (int row = 0; row < src->height; row++) {
+        const uint8_t* actual = out->data[0] + (ptrdiff_t)row * out->linesize[0];
+        const uint8_t* expected = scaled->data[0] + (ptrdiff_t)row * scaled->linesize[0];
+        for (int i = 0; i < src->width * 4; i++) {
+            if (abs(actual[i] - expected[i]) > 1) {
+                report(isa, (enum AVPixelFormat)src->format, (enum AVPixelFormat)out->format,
+                    src->width, src->height, "differs from swscale by more than 1", row, i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void test_kernel(const KernelIsa* isa, enum AVPixelFormat src_format, enum AVPixelFormat dst_format) {
+    PrismYuvKernel kernel;
+    if (!prism_yuv_kernel_init(&kernel, src_format, dst_format, isa->cpu_flag) ||
+        strcmp(kernel.name, isa->name) != 0) {
+        report(isa->name, src_format, dst_format, 0, 0, "kernel not selected", 0, 0);
+        return;
+    }
+
+    size_t count = sizeof(g_widths) / sizeof(g_widths[0]);
+    for (size_t i = 0; i < count; i++) {
+        /* Odd heights end on a row without its chroma pair */
+        int width = g_widths[i];
+        int height = 2 + (int)(i % 5);
+
+        AVFrame* src = alloc_frame(src_format, width, height);
+        AVFrame* out = alloc_frame(dst_format, width, height);
+        AVFrame* scaled = alloc_frame(dst_format, width, height);
+        uint8_t* expected = (uint8_t*)malloc((size_t)width * 4);
+        if (!src || !out || !scaled || !expected) {
+            report(isa->name, src_format, dst_format, width, height, "out of memory", 0, 0);
+        } else {
+            fill_random(src, false);
+            prism_yuv_kernel_convert(&kernel, src, out, 0, height);
+            check_reference(&kernel, src, out, expected, isa->name);
+
+            fill_random(src, true);
+            prism_yuv_kernel_convert(&kernel, src, out, 0, height);
+            if (check_reference(&kernel, src, out, expected, isa->name)) {
+                check_swscale(src, out, scaled, isa->name);
+            }
+        }
+
+        free(expected);
+        av_frame_free(&scaled);
+        av_frame_free(&out);
+        av_frame_free(&src);
+    }
+}
+
+int main(void) {
+    int host_flags = av_get_cpu_flags();
+    int tested = 0;
+
+    for (size_t i = 0; i < sizeof(g_isas) / sizeof(g_isas[0]); i++) {
+        if (!(host_flags & g_isas[i].cpu_flag)) {
+            printf("skip %s: not supported by this CPU\n", g_isas[i].name);
+            continue;
+        }
+        for (size_t s = 0; s < sizeof(g_src_formats) / sizeof(g_src_formats[0]); s++) {
+            for (size_t d = 0; d < sizeof(g_dst_formats) / sizeof(g_dst_formats[0]); d++) {
+                test_kernel(&g_isas[i], g_src_formats[s], g_dst_formats[d]);
+            }
+        }
+        printf("%s: tested\n", g_isas[i].name);
+        tested++;
+    }
+
+    if (tested == 0) {
+        printf("no SIMD kernel for this CPU\n");
+    }
+    if (g_failures > 0) {
+        fprintf(stderr, "%d failure(s)\n", g_failures);
+        return 1;
+    }
+    return 0;
+}
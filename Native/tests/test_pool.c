@@ -0,0 +1,144 @@
+/*
+ * Prism FFmpeg Native Plugin - Frame buffer pool tests
+ *
+ * Checks that pool buffers start on a PRISM_FRAME_ALIGN boundary, with and
+ * without huge pages, that every prism_frame_pool_get caller asking for a
+ * size shares one AVBufferPool, and that a pool released by its last user
+ * keeps its buffers for the next one while prism_frame_pool_clear frees
+ * only unused pools.
+ *
+ * MIT License - see LICENSE file
+ */
+
+#include "prism_pool.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libavutil/buffer.h>
+
+/* Odd and page-sized sizes, and a 1080p RGBA frame for the huge page path */
+static const size_t g_sizes[] = {
+    1, 63, 65, 4096, 320 * 240 * 4 + 13, (size_t)1920 * 1080 * 4
+};
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL %s\n", what);
+        g_failures++;
+    }
+}
+
+static bool is_aligned(const AVBufferRef* buf) {
+    return ((uintptr_t)buf->data % PRISM_FRAME_ALIGN) == 0;
+}
+
+/* Every buffer of a few held at once is aligned and writable to its end */
+static void test_alignment(bool huge_pages) {
+    prism_frame_pool_set_huge_pages(huge_pages);
+    for (size_t i = 0; i < sizeof(g_sizes) / sizeof(g_sizes[0]); i++) {
+        AVBufferPool* pool = prism_frame_pool_get(g_sizes[i]);
+        check(pool != NULL, "alignment: pool");
+        if (!pool) {
+            continue;
+        }
+
+        AVBufferRef* bufs[3] = { NULL };
+        for (int b = 0; b < 3; b++) {
+            bufs[b] = av_buffer_pool_get(pool);
+            check(bufs[b] != NULL, "alignment: buffer");
+            if (bufs[b]) {
+                check(is_aligned(bufs[b]), huge_pages ? "alignment: huge page buffer" : "alignment: buffer");
+                check(bufs[b]->size == g_sizes[i], "alignment: buffer size");
+                memset(bufs[b]->data, 0xA5, bufs[b]->size);
+            }
+        }
+        for (int b = 0; b < 3; b++) {
+            av_buffer_unref(&bufs[b]);
+        }
+        prism_frame_pool_release(&pool);
+        check(pool == NULL, "alignment: release clears the pointer");
+    }
+    prism_frame_pool_clear();
+    prism_frame_pool_set_huge_pages(false);
+}
+
+/* Callers asking for the same size share a pool; other sizes do not */
+static void test_sharing(void) {
+    AVBufferPool* first = prism_frame_pool_get(640 * 360 * 4);
+    AVBufferPool* second = prism_frame_pool_get(640 * 360 * 4);
+    AVBufferPool* other = prism_frame_pool_get(1280 * 720 * 4);
+    check(first && second && other, "sharing: pools");
+    check(first == second, "sharing: same size, same pool");
+    check(other != first, "sharing: other size, other pool");
+
+    /* A buffer one user returns is handed to the other */
+    AVBufferRef* buf = av_buffer_pool_get(first);
+    uint8_t* data = buf ? buf->data : NULL;
+    av_buffer_unref(&buf);
+    buf = av_buffer_pool_get(second);
+    check(buf && buf->data == data, "sharing: buffer reused across users");
+    av_buffer_unref(&buf);
+
+    /* Still shared after one user leaves */
+    prism_frame_pool_release(&first);
+    AVBufferPool* third = prism_frame_pool_get(640 * 360 * 4);
+    check(third == second, "sharing: pool kept while in use");
+
+    prism_frame_pool_release(&third);
+    prism_frame_pool_release(&second);
+    prism_frame_pool_release(&other);
+    prism_frame_pool_clear();
+}
+
+/* A pool without users keeps its buffers for the next get of its size */
+static void test_reuse(void) {
+    size_t size = 800 * 600 * 4;
+    AVBufferPool* pool = prism_frame_pool_get(size);
+    AVBufferRef* buf = pool ? av_buffer_pool_get(pool) : NULL;
+    check(buf != NULL, "reuse: buffer");
+    uint8_t* data = buf ? buf->data : NULL;
+    av_buffer_unref(&buf);
+    AVBufferPool* released = pool;
+    prism_frame_pool_release(&pool);
+
+    pool = prism_frame_pool_get(size);
+    check(pool == released, "reuse: released pool handed out again");
+    buf = pool ? av_buffer_pool_get(pool) : NULL;
+    check(buf && buf->data == data, "reuse: buffer kept across release");
+
+    /* A buffer outlives the release of its pool */
+    prism_frame_pool_release(&pool);
+    if (buf) {
+        memset(buf->data, 0x5A, buf->size);
+    }
+    av_buffer_unref(&buf);
+
+    /* Clearing keeps pools in use and frees the rest */
+    AVBufferPool* in_use = prism_frame_pool_get(size);
+    AVBufferPool* unused = prism_frame_pool_get(size / 2);
+    prism_frame_pool_release(&unused);
+    prism_frame_pool_clear();
+    AVBufferPool* again = prism_frame_pool_get(size);
+    check(again == in_use, "reuse: pool in use survives clear");
+    prism_frame_pool_release(&again);
+    prism_frame_pool_release(&in_use);
+    prism_frame_pool_clear();
+}
+
+int main(void) {
+    test_alignment(false);
+    test_alignment(true);
+    test_sharing();
+    test_reuse();
+
+    if (g_failures > 0) {
+        fprintf(stderr, "%d failure(s)\n", g_failures);
+        return 1;
+    }
+    printf("pool: tested\n");
+    return 0;
+}
@@ -31,7 +31,54 @@ namespace Prism.FFmpeg
             RGBA = 0,
             BGRA = 1,
             RGB24 = 2,
-            YUV420P = 3
+            YUV420P = 3,
+            NV12 = 4
+        }
+
+        public enum PrismColorMatrix
+        {
+            BT601 = 0,
+            BT709 = 1,
+            BT2020 = 2
+        }
+
+        public enum PrismColorRange
+        {
+            Limited = 0,
+            Full = 1
+        }
+
+        public enum PrismSeekMode
+        {
+            Keyframe = 0,
+            Exact = 1
+        }
+
+        public enum PrismThreadMode
+        {
+            Auto = 0,
+            Frame = 1,
+            Slice = 2
+        }
+
+        public enum PrismOpenProfile
+        {
+            Default = 0,
+            Fast = 1
+        }
+
+        public enum PrismFileBackend
+        {
+            Default = 0,
+            Mmap = 1
+        }
+
+        public enum PrismAbrReason
+        {
+            None = 0,
+            BandwidthUp = 1,
+            BandwidthDown = 2,
+            DecodeHeadroom = 3
         }
 
         public enum PrismState
@@ -80,6 +127,24 @@ namespace Prism.FFmpeg
             public IntPtr codecName; // const char*
         }
 
+        [StructLayout(LayoutKind.Sequential)]
+        public struct PrismVideoPlanes
+        {
+            public PrismPixelFormat format;
+            public int width;
+            public int height;
+            public int planeCount;
+            public IntPtr data0; // const uint8_t* data[3]
+            public IntPtr data1;
+            public IntPtr data2;
+            public int stride0;
+            public int stride1;
+            public int stride2;
+            public PrismColorMatrix matrix;
+            public PrismColorRange range;
+            public double pts;
+        }
+
         [StructLayout(LayoutKind.Sequential)]
         public struct PrismAudioInfo
         {
@@ -90,6 +155,77 @@ namespace Prism.FFmpeg
             public IntPtr codecName; // const char*
         }
 
+        [StructLayout(LayoutKind.Sequential)]
+        public struct PrismPlayerStats
+        {
+            public long framesConverted;
+            public double convertMsLast;
+            public double convertMsAvg;
+            public double convertMsMax;
+            public int convertThreads;
+            public int decodeThreads;
+            public int indexKeyframes;
+            public double openMs;
+            public double probeMs;
+            public int openWarm;
+            public double liveLatency;
+            public double liveRate;
+            public long liveFramesDropped;
+            public long readAheadBuffered;
+            public double readAheadFillRate;
+            public long readAheadStalls;
+            public double demuxReadMs;
+            public long demuxBytes;
+            public PrismFileBackend fileBackend;
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct PrismAbrInfo
+        {
+            public int active;
+            public int variantCount;
+            public int currentVariant;
+            public long currentBitrate;
+            public double bandwidth;
+            public double decodeMs;
+            public int switches;
+            public PrismAbrReason lastReason;
+            public double lastSwitchTime;
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct PrismAbrVariant
+        {
+            public long bitrate;
+            public int width;
+            public int height;
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct PrismThumbnailOptions
+        {
+            public int count;
+            public int tileWidth;
+            public int tileHeight;
+            public int columns;
+            public int threads;
+            public PrismPixelFormat format;
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct PrismThumbnails
+        {
+            public IntPtr atlas;        // uint8_t*
+            public IntPtr timestamps;   // double*
+            public int atlasWidth;
+            public int atlasHeight;
+            public int atlasStride;
+            public int tileWidth;
+            public int tileHeight;
+            public int columns;
+            public int count;
+        }
+
         // ============================================================================
         // Delegates for callbacks
         // ============================================================================
@@ -100,6 +236,9 @@ namespace Prism.FFmpeg
         [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
         public delegate void VideoFrameCallback(IntPtr userData, IntPtr data, int width, int height, int stride, double pts);
 
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        public delegate void VideoSizeCallback(IntPtr userData, int width, int height);
+
         [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
         public delegate void AudioSamplesCallback(IntPtr userData, IntPtr samples, int numSamples, int channels, double pts);
 
@@ -122,6 +261,21 @@ namespace Prism.FFmpeg
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern void prism_set_log_callback(LogCallback callback);
 
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_set_core_budget(int cores);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int prism_get_core_budget();
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_set_index_cache_dir([MarshalAs(UnmanagedType.LPStr)] string path);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_set_media_cache([MarshalAs(UnmanagedType.LPStr)] string path, long maxBytes);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_set_huge_pages([MarshalAs(UnmanagedType.I1)] bool enabled);
+
         // ============================================================================
         // Player Lifecycle
         // ============================================================================
@@ -150,6 +304,16 @@ namespace Prism.FFmpeg
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern int prism_player_play(IntPtr player);
 
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int prism_player_prepare(IntPtr player);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool prism_player_is_prepared(IntPtr player);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_preroll(IntPtr player, double seconds);
+
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern int prism_player_pause(IntPtr player);
 
@@ -159,6 +323,15 @@ namespace Prism.FFmpeg
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern int prism_player_seek(IntPtr player, double positionSeconds);
 
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int prism_player_seek_with_mode(IntPtr player, double positionSeconds, PrismSeekMode mode);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern uint prism_player_get_command_serial(IntPtr player);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern uint prism_player_get_completed_serial(IntPtr player);
+
         // ============================================================================
         // State and Info
         // ============================================================================
@@ -188,6 +361,18 @@ namespace Prism.FFmpeg
         [return: MarshalAs(UnmanagedType.I1)]
         public static extern bool prism_player_get_audio_info(IntPtr player, out PrismAudioInfo info);
 
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool prism_player_get_stats(IntPtr player, out PrismPlayerStats stats);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool prism_player_get_abr_info(IntPtr player, out PrismAbrInfo info);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool prism_player_get_abr_variant(IntPtr player, int index, out PrismAbrVariant variant);
+
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern double prism_player_get_position(IntPtr player);
 
@@ -208,6 +393,10 @@ namespace Prism.FFmpeg
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr prism_player_get_video_frame(IntPtr player, out int width, out int height, out int stride);
 
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool prism_player_get_video_planes(IntPtr player, out PrismVideoPlanes planes);
+
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern double prism_player_get_video_pts(IntPtr player);
 
@@ -237,6 +426,12 @@ namespace Prism.FFmpeg
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern void prism_player_set_pixel_format(IntPtr player, PrismPixelFormat format);
 
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_output_size(IntPtr player, int width, int height);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_lowres(IntPtr player, [MarshalAs(UnmanagedType.I1)] bool enabled);
+
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern void prism_player_set_loop(IntPtr player, [MarshalAs(UnmanagedType.I1)] bool loop);
 
@@ -259,6 +454,36 @@ namespace Prism.FFmpeg
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern void prism_player_set_hardware_acceleration(IntPtr player, [MarshalAs(UnmanagedType.I1)] bool enabled);
 
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_decode_threads(IntPtr player, PrismThreadMode mode, int threadCount);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int prism_player_get_decode_threads(IntPtr player);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_open_profile(IntPtr player, PrismOpenProfile profile);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_low_latency(IntPtr player, [MarshalAs(UnmanagedType.I1)] bool enabled, double targetLatency);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_convert_threads(IntPtr player, int threadCount);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int prism_player_get_convert_threads(IntPtr player);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_keyframe_index(IntPtr player, [MarshalAs(UnmanagedType.I1)] bool enabled);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_read_ahead(IntPtr player, long sizeBytes);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_file_backend(IntPtr player, PrismFileBackend backend);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_abr(IntPtr player, [MarshalAs(UnmanagedType.I1)] bool enabled);
+
         // ============================================================================
         // Callbacks
         // ============================================================================
@@ -266,9 +491,23 @@ namespace Prism.FFmpeg
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern void prism_player_set_video_callback(IntPtr player, VideoFrameCallback callback, IntPtr userData);
 
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_player_set_video_size_callback(IntPtr player, VideoSizeCallback callback, IntPtr userData);
+
         [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
         public static extern void prism_player_set_audio_callback(IntPtr player, AudioSamplesCallback callback, IntPtr userData);
 
+        // ============================================================================
+        // Thumbnails
+        // ============================================================================
+
+        // Returns a PrismThumbnails*, free with prism_thumbnails_free
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr prism_thumbnails_generate([MarshalAs(UnmanagedType.LPStr)] string url, ref PrismThumbnailOptions options);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void prism_thumbnails_free(IntPtr thumbnails);
+
         // ============================================================================
         // Helper methods
         // ============================================================================
@@ -60,6 +60,7 @@ namespace Prism.FFmpeg
         private string _resolvedUrl;
         private GCHandle _audioBufferHandle;
         private float[] _audioBuffer;
+        private byte[] _frameRows;
         private AudioSource _audioSource;
 
         // Audio ring buffer for smooth playback
@@ -612,8 +613,22 @@ namespace Prism.FFmpeg
                 CreateVideoTexture(width, height);
             }
 
-            // Load frame data directly to texture
-            _videoTexture.LoadRawTextureData(frameData, width * height * 4);
+            // Load frame data directly to texture. Converted frames are tightly
+            // packed; decoder frames passed through can have padded rows, which
+            // are packed first
+            int rowBytes = width * 4;
+            if (stride == rowBytes)
+            {
+                _videoTexture.LoadRawTextureData(frameData, rowBytes * height);
+            }
+            else
+            {
+                if (_frameRows == null || _frameRows.Length != rowBytes * height)
+                    _frameRows = new byte[rowBytes * height];
+                for (int y = 0; y < height; y++)
+                    Marshal.Copy(IntPtr.Add(frameData, y * stride), _frameRows, y * rowBytes, rowBytes);
+                _videoTexture.LoadRawTextureData(_frameRows);
+            }
             _videoTexture.Apply(false);
 
             // Blit to render texture if set